@@ -34,6 +34,8 @@ write(M, 'c-cnc/setpoint', '{"x":0.000,"y":0.000,"z":-100.000,"rapid":false}');
 % 2. setpoint is the set-point topic
 % 3. {x,y,z,rapid} is the message formatted as x, y and z set points and
 %    a rapid movement flag (false=no rapid movement, true=rapid movement).
+% With payload = binary64 or binary32 in settings.ini the same data comes
+% as a packed binary message; get_setpoint decodes both (decode_setpoint.m).
 
 % Simulation pub messages
 % Published by the simulation.
@@ -0,0 +1,27 @@
+function seg = decode_segment(data)
+%DECODE_SEGMENT Decode a c-cnc trajectory segment payload
+%   seg = DECODE_SEGMENT(data) returns a struct with the geometry and the
+%   velocity profile of a whole block, as streamed with stream = segments
+%   in settings.ini (see src/segment.h). Segment payloads start with the
+%   0xCD magic byte. Sample the segment with eval_segment.
+
+  bytes = uint8(char(data));
+  if numel(bytes) < 200 || bytes(1) ~= hex2dec('CD')
+    error('decode_segment:format', 'Unknown segment payload');
+  end
+  if bytes(2) ~= 1
+    error('decode_segment:version', 'Unsupported payload version %d', bytes(2));
+  end
+  % typecast uses the host byte order: MATLAB only runs on little endian hosts
+  v = typecast(bytes(17:200), 'double');
+  seg = struct( ...
+    'type', double(bytes(3)), ... % 1 line, 2 arc CW, 3 arc CCW
+    'rapid', bitand(bytes(4), 1) ~= 0, ...
+    'seq', double(typecast(bytes(5:8), 'uint32')), ...
+    'n', double(typecast(bytes(9:12), 'uint32')), ...
+    't0', v(1), 'p0', v(2:4)', 'delta', v(5:7)', 'center', v(8:10)', ...
+    'r', v(11), 'theta0', v(12), 'dtheta', v(13), 'l', v(14), ...
+    'fs', v(15), 'f', v(16), 'fe', v(17), 'a', v(18), 'd', v(19), ...
+    'dt_1', v(20), 'dt_m', v(21), 'dt_2', v(22), 'dt', v(23));
+
+end
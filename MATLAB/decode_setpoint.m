@@ -0,0 +1,74 @@
+function sp = decode_setpoint(data)
+%DECODE_SETPOINT Decode a c-cnc setpoint payload
+%   sp = DECODE_SETPOINT(data) returns a struct with fields x, y, z, rapid,
+%   seq, t (ns), and the feed-forward velocities vx, vy, vz and
+%   accelerations ax, ay, az (0 unless feed_forward = 1 in settings.ini),
+%   from either a JSON or a binary payload (see src/setpoint.h): binary
+%   payloads start with the 0xCC magic byte, JSON ones with '{'. Batched
+%   payloads (batch > 1 in settings.ini) give a struct array, oldest
+%   setpoint first.
+
+  bytes = uint8(char(data));
+  if isempty(bytes)
+    error('decode_setpoint:empty', 'Empty setpoint payload');
+  end
+
+  % JSON payload: a single object, or an array of objects
+  if bytes(1) == uint8('{') || bytes(1) == uint8('[')
+    sp = jsondecode(char(bytes));
+    if ~isfield(sp, 'seq'), [sp.seq] = deal(0); end
+    if ~isfield(sp, 't'), [sp.t] = deal(0); end
+    for f = {'vx', 'vy', 'vz', 'ax', 'ay', 'az'}
+      if ~isfield(sp, f{1}), [sp.(f{1})] = deal(0); end
+    end
+    return
+  end
+
+  % binary payload: one or more setpoints, each made of a 16 bytes header
+  % and packed x, y, z (little endian), followed by vx, vy, vz, ax, ay, az
+  % if the feed-forward flag (0x02) is set: records have their own length
+  if numel(bytes) < 16 || bytes(1) ~= hex2dec('CC')
+    error('decode_setpoint:format', 'Unknown setpoint payload');
+  end
+  if bytes(2) ~= 1
+    error('decode_setpoint:version', 'Unsupported payload version %d', bytes(2));
+  end
+  w = double(bytes(3)); % bytes per coordinate
+  sp = repmat(empty_setpoint(), 0, 1);
+  % typecast uses the host byte order: MATLAB only runs on little endian hosts
+  p = 0;
+  while p + 16 <= numel(bytes) && bytes(p + 1) == hex2dec('CC')
+    ff = bitand(bytes(p + 4), 2) ~= 0;
+    if ff, m = 9; else, m = 3; end
+    len = 16 + m * w;
+    if p + len > numel(bytes), break; end
+    b = bytes(p + (1:len));
+    r = empty_setpoint();
+    r.rapid = bitand(b(4), 1) ~= 0;
+    r.seq = double(typecast(b(5:8), 'uint32'));
+    r.t = typecast(b(9:16), 'uint64');
+    if w == 4
+      v = double(typecast(b(17:len), 'single'));
+    else
+      v = typecast(b(17:len), 'double');
+    end
+    r.x = v(1);
+    r.y = v(2);
+    r.z = v(3);
+    if ff
+      r.vx = v(4); r.vy = v(5); r.vz = v(6);
+      r.ax = v(7); r.ay = v(8); r.az = v(9);
+    end
+    sp(end + 1, 1) = r; %#ok<AGROW>
+    p = p + len;
+  end
+  if isempty(sp)
+    error('decode_setpoint:length', 'Truncated setpoint payload');
+  end
+
+end
+
+function r = empty_setpoint()
+  r = struct('x', 0, 'y', 0, 'z', 0, 'vx', 0, 'vy', 0, 'vz', 0, ...
+    'ax', 0, 'ay', 0, 'az', 0, 'rapid', false, 'seq', 0, 't', uint64(0));
+end
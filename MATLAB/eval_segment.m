@@ -0,0 +1,48 @@
+function [xyz, v] = eval_segment(seg, t)
+%EVAL_SEGMENT Sample a c-cnc trajectory segment
+%   [xyz, v] = EVAL_SEGMENT(seg, t) returns the setpoint (one row per
+%   element of t) and the feedrate (mm/s) at times t from the segment start,
+%   for a segment from decode_segment. Same as segment_eval() in
+%   src/segment.c: trapezoidal profile of the curvilinear abscissa, mapped
+%   on the line or arc.
+
+  t = t(:);
+  t1 = seg.dt_1;
+  t2 = seg.dt_1 + seg.dt_m;
+  t3 = t2 + seg.dt_2;
+  r = zeros(size(t));
+  v = zeros(size(t));
+
+  i = t <= 0;
+  v(i) = seg.fs;
+  i = t > 0 & t < t1;
+  r(i) = seg.fs * t(i) + seg.a * t(i).^2 / 2;
+  v(i) = seg.fs + seg.a * t(i);
+  i = t >= t1 & t < t2;
+  r(i) = (seg.fs + seg.f) / 2 * t1 + seg.f * (t(i) - t1);
+  v(i) = seg.f;
+  i = t >= t2 & t < t3;
+  tau = t(i) - t2;
+  r(i) = (seg.fs + seg.f) / 2 * t1 + seg.f * seg.dt_m + seg.f * tau + seg.d / 2 * tau.^2;
+  v(i) = seg.f + seg.d * tau;
+  i = t >= t3;
+  r(i) = seg.l;
+  v(i) = seg.fe;
+
+  if seg.l > 0
+    lambda = min(r / seg.l, 1);
+  else
+    lambda = ones(size(t));
+    v(:) = 0;
+  end
+  if seg.type == 2 || seg.type == 3
+    x = seg.center(1) + seg.r * cos(seg.theta0 + seg.dtheta * lambda);
+    y = seg.center(2) + seg.r * sin(seg.theta0 + seg.dtheta * lambda);
+  else
+    x = seg.p0(1) + seg.delta(1) * lambda;
+    y = seg.p0(2) + seg.delta(2) * lambda;
+  end
+  z = seg.p0(3) + seg.delta(3) * lambda;
+  xyz = [x, y, z];
+
+end
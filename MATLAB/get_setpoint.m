@@ -1,8 +1,16 @@
 function get_setpoint(topic,data)
-%UNTITLED Summary of this function goes here
-%   Detailed explanation goes here
+%GET_SETPOINT Callback for the c-cnc/setpoint topic
+%   Decodes the setpoint (JSON or binary, see decode_setpoint) into the
+%   base workspace variable position. With stream = segments, whole blocks
+%   arrive instead, and are decoded into the base workspace variable
+%   segment (see decode_segment and eval_segment)
 
   assignin('base','payload',data);
-  assignin('base','position',jsondecode(data));
+  bytes = uint8(char(data));
+  if ~isempty(bytes) && bytes(1) == hex2dec('CD')
+    assignin('base','segment',decode_segment(data));
+  else
+    assignin('base','position',decode_setpoint(data));
+  end
 
-end
\ No newline at end of file
+end
@@ -10,6 +10,7 @@
 #include "defines.h"
 #include "point.h"
 #include "machine.h"
+#include "segment.h"
 
 //   _____                      
 //  |_   _|   _ _ __   ___  ___ 
@@ -55,9 +56,28 @@ data_t block_lambda(const block_t *b, data_t time, data_t *v);
 // Interpolate lambda over three axes
 point_t *block_interpolate(block_t *b, data_t lambda);
 
+// Acceleration along the path (mm/s^2) at a certain time
+data_t block_acceleration(const block_t *b, data_t time);
+
+// Velocity (mm/s) and acceleration (mm/s^2) of each axis at a certain time,
+// as needed for feed-forward
+void block_derivatives(const block_t *b, data_t time, data_t v[3], data_t a[3]);
+
+// Highest feed override that the profile can take at a certain time, so
+// that it can still brake as planned (see override.h)
+data_t block_override_limit(const block_t *b, data_t time);
+
+// Fill s with the geometry and velocity profile of the block, starting at
+// time t0 on the program clock (see segment.h)
+void block_segment(const block_t *b, coord_t t0, segment_t *s);
+
 
 // GETTERS =====================================================================
+// static inline with CCNC_INLINE (see block_layout.h)
 
+#if defined(CCNC_INLINE) && !defined(BLOCK_IMPL)
+#include "block_layout.h"
+#else
 data_t block_length(const block_t *b);
 data_t block_dtheta(const block_t *b);
 data_t block_dt(const block_t *b);
@@ -69,6 +89,8 @@ point_t *block_center(const block_t *b);
 block_t *block_next(const block_t *b);
 block_t *block_prev(const block_t *b);
 point_t *block_target(const block_t *b);
+point_t *block_delta(const block_t *b);
+#endif
 
 
 
@@ -83,6 +105,15 @@ point_t *block_target(const block_t *b);
 
 int block_parse_partial(block_t *b);
 
-static data_t block_alpha(block_t *b);
+// Junction feedrate limit (backward pass): call from the last block back to
+// the first one, after block_parse_partial() and before block_parse(); alpha
+// is the cosine of the angle between the deltas of this block and the next
+// one (see program_parse())
+void block_lookahead(block_t *b, data_t alpha);
+
+// Feedrate (mm/s) at the end of the block, once planned
+#if !defined(CCNC_INLINE) || defined(BLOCK_IMPL)
+data_t block_fe(const block_t *b);
+#endif
 
 #endif // BLOCK_H
\ No newline at end of file
@@ -0,0 +1,97 @@
+//   ____  _            _      _                         _
+//  | __ )| | ___   ___| | __ | | __ _ _   _  ___  _   _| |_
+//  |  _ \| |/ _ \ / __| |/ / | |/ _` | | | |/ _ \| | | | __|
+//  | |_) | | (_) | (__|   <  | | (_| | |_| | (_) | |_| | |_
+//  |____/|_|\___/ \___|_|\_\ |_|\__,_|\__, |\___/ \__,_|\__|
+//                                     |___/
+//  Layout of block_t, and its getters as static inline functions for the
+//  hot paths (with CCNC_INLINE, see point_layout.h)
+
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include "block_la.h"
+#include "lockfree.h"
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Trapezoidal velocity profile
+typedef struct {
+  data_t a, d;             // acceleration
+  data_t f, l;             // nominal feedrate and length
+  data_t fs, fe;           // initial and final feedrate
+  data_t dt_1, dt_m, dt_2; // trapezoid times
+  data_t dt;               // total time
+  data_t alpha;            // cos(alpha)
+} block_profile_t;
+
+// Block object structure, in two parts. The hot one holds what the control
+// loop reads on every tick (block_lambda(), block_interpolate(),
+// block_derivatives(), the getters of the state machine, and the target of
+// the previous block, as the start point of this one); the cold one what
+// only parsing and planning use. Each part starts on its own cache line; the
+// hot one spans three (with double data_t)
+struct block {
+  // hot
+  _Alignas(LF_CACHELINE)
+  block_profile_t prof;  // velocity profile
+  block_type_t type;     // type of block
+  data_t r;              // radius (if it is an arc)
+  data_t theta0, dtheta; // arc initial angle and arc angle
+  point_t *delta;        // distance vector w.r.t. previous point
+  point_t *center;       // arc center (if it is an arc)
+  point_t *target;       // destination point
+  struct block *prev;    // previous block (linked list)
+  machine_t *machine;    // machine configuration
+  size_t n;              // block number
+  data_t length;         // total length
+  // cold
+  _Alignas(LF_CACHELINE)
+  char *line;            // G-code line
+  size_t tool;           // tool number
+  data_t feedrate;       // nominal feedrate
+  data_t act_feedrate;   // actual feedrate (possibly reduced along arcs)
+  data_t spindle;        // spindle rate
+  data_t i, j;           // center coordinates (if it is an arc)
+  data_t acc;            // actual acceleration
+  data_t f_j;            // junction feedrate towards next block (mm/s)
+  struct block *next;    // next block
+};
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+#if defined(CCNC_INLINE) && !defined(BLOCK_IMPL)
+
+// GETTERS =====================================================================
+
+#define block_getter(typ, par, name) \
+static inline typ block_##name(const block_t *b) { assert(b); return b->par; }
+
+block_getter(data_t, length, length);
+block_getter(data_t, dtheta, dtheta);
+block_getter(data_t, prof.dt, dt);
+block_getter(data_t, prof.fe, fe);
+block_getter(block_type_t, type, type);
+block_getter(char *, line, line);
+block_getter(size_t, n, n);
+block_getter(data_t, r, r);
+block_getter(point_t *, center, center);
+block_getter(block_t *, next, next);
+block_getter(block_t *, prev, prev);
+block_getter(point_t *, target, target);
+block_getter(point_t *, delta, delta);
+
+#undef block_getter
+
+#endif
+
+#endif // BLOCK_LAYOUT_H
@@ -5,7 +5,9 @@
 //  |____/|_|\___/ \___|_|\_\
 
 // #include "block.h"
-#include "block_la.h"
+// this file defines the out-of-line getters
+#define BLOCK_IMPL
+#include "block_layout.h"
 #include <ctype.h>
 
 //   ____            _                 _   _
@@ -14,46 +16,15 @@
 //  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
 //  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
 
-// Trapezoidal velocity profile
-typedef struct {
-  data_t a, d;             // acceleration
-  data_t f, l;             // nominal feedrate and length
-  data_t fs, fe;           // initial and final feedrate
-  data_t dt_1, dt_m, dt_2; // trapezoid times
-  data_t dt;               // total time
-  data_t alpha;            // cos(alpha)
-} block_profile_t;
-
-// Block object structure
-typedef struct block {
-  char *line;            // G-code line
-  block_type_t type;     // type of block
-  size_t n;              // block number
-  size_t tool;           // tool number
-  data_t feedrate;       // nominal feedrate
-  data_t act_feedrate;   // actual feedrate (possibly reduced along arcs)
-  data_t spindle;        // spindle rate
-  point_t *target;       // destination point
-  point_t *delta;        // distance vector w.r.t. previous point
-  point_t *center;       // arc center (if it is an arc)
-  data_t length;         // total length
-  data_t i, j, r;        // center coordinates and radius (if it is an arc)
-  data_t theta0, dtheta; // arc initial angle and arc angle
-  data_t acc;            // actual acceleration
-  machine_t *machine;    // machine configuration
-  block_profile_t *prof; // velocity profile
-  struct block *prev;    // next block (linked list)
-  struct block *next;    // previous block
-} block_t;
-
 // STATIC FUNCTIONS (for internal use only) ====================================
 static int block_set_fields(block_t *b, char cmd, char *arg);
 static point_t *point_zero(block_t *b);
 static void block_compute(block_t *b);
+static void profile_compute(block_profile_t *prof, data_t l, data_t fs, data_t f, data_t fe, data_t A, data_t tq);
+static data_t block_junction(const block_t *b, data_t alpha);
+static data_t profile_length(data_t f, data_t fs, data_t fe, data_t A, data_t dt);
 static int block_arc(block_t *b);
 static data_t quantize(data_t t, data_t tq, data_t *dq);
-static data_t block_alpha(block_t *b);
-// static void block_velocity(block_t *b);
 
 //   _____                 _   _
 //  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
@@ -65,11 +36,13 @@ static data_t block_alpha(block_t *b);
 
 block_t *block_new(const char *line, block_t *prev, machine_t *cfg) {
   assert(line && cfg); // prev is NULL if this is the first block
-  block_t *b = (block_t *)calloc(1, sizeof(block_t));
-  if (!b) {
+  block_t *b = NULL;
+  // aligned for the hot part (see block_layout.h)
+  if (posix_memalign((void **)&b, LF_CACHELINE, sizeof(block_t))) {
     perror("Could not allocate block");
     return NULL;
   }
+  memset(b, 0, sizeof(block_t));
 
   if (prev) { // copy the memory from the previous block
     memcpy(b, prev, sizeof(block_t));
@@ -88,12 +61,8 @@ block_t *block_new(const char *line, block_t *prev, machine_t *cfg) {
   b->delta = point_new();
   b->center = point_new();
 
-  // allocate memory for profile struct
-  b->prof = (block_profile_t *)calloc(1, sizeof(block_profile_t));
-  if (!b->prof) {
-    perror("Could not allocate profile structure");
-    return NULL;
-  }
+  // the profile is planned later
+  memset(&b->prof, 0, sizeof(block_profile_t));
 
   b->machine = cfg;
   b->type = NO_MOTION;
@@ -111,8 +80,6 @@ void block_free(block_t *b) {
   assert(b);
   if (b->line)
     free(b->line);
-  if (b->prof)
-    free(b->prof);
   point_free(b->target);
   point_free(b->center);
   point_free(b->delta);
@@ -166,6 +133,18 @@ int block_parse_partial(block_t *b) {
   
   // deal with motion blocks
   switch (b->type) {
+  case RAPID: {
+    // synchronized axes: the path feed is the largest one that keeps every
+    // axis within its own max velocity
+    point_t *v = machine_rapid_v(b->machine);
+    data_t f = INFINITY;
+    if (point_x(b->delta)) f = MIN(f, point_x(v) * b->length / fabs(point_x(b->delta)));
+    if (point_y(b->delta)) f = MIN(f, point_y(v) * b->length / fabs(point_y(b->delta)));
+    if (point_z(b->delta)) f = MIN(f, point_z(v) * b->length / fabs(point_z(b->delta)));
+    b->act_feedrate = isinf(f) ? 0 : f;
+    b->acc = machine_A(b->machine);
+    break;
+  }
   case LINE:
     // calculate feed profile
     b->acc = machine_A(b->machine);
@@ -210,10 +189,11 @@ int block_parse_partial(block_t *b) {
 }
 
 
+// Plan the velocity profile. Needs the previous block already planned and
+// block_lookahead() called on this one (see program_parse())
 int block_parse(block_t *b) {
   assert(b);
-  block_velocity(b);
-  block_acc(b);
+  block_compute(b);
   return 0;
 }
 
@@ -223,41 +203,47 @@ int block_parse(block_t *b) {
 
 
 // Evaluate the value of lambda at a certaint time
+// Accelerations a and d are signed, so that each phase may either speed up
+// or slow down, starting from fs and ending at fe
 data_t block_lambda(const block_t *b, data_t t, data_t *v) {
   assert(b);
-  data_t r;
-  data_t dt_1 = b->prof->dt_1;
-  data_t dt_2 = b->prof->dt_2;
-  data_t dt_m = b->prof->dt_m;
-  data_t a = b->prof->a;
-  data_t d = b->prof->d;
-  data_t f = b->prof->f;
-
+  data_t r, tau;
+  data_t dt_1 = b->prof.dt_1;
+  data_t dt_2 = b->prof.dt_2;
+  data_t dt_m = b->prof.dt_m;
+  data_t a = b->prof.a;
+  data_t d = b->prof.d;
+  data_t f = b->prof.f;
+  data_t fs = b->prof.fs;
+
+  if (b->prof.l <= 0) {
+    *v = 0;
+    return 1.0;
+  }
   if (t < 0) {
     r = 0.0;
-    *v = 0.0;
+    *v = fs;
   }
   else if (t < dt_1) { // acceleration
-    r = a * pow(t, 2) / 2.0;
-    *v = a * t;
+    r = fs * t + a * pow(t, 2) / 2.0;
+    *v = fs + a * t;
   }
   else if (t < (dt_1 + dt_m)) { // maintenance
-    r = f * (dt_1 / 2.0 + (t - dt_1));
+    r = (fs + f) / 2.0 * dt_1 + f * (t - dt_1);
     *v = f;
   }
   else if (t < (dt_1 + dt_m + dt_2)) { // deceleration
-    data_t t_2 = dt_1 + dt_m;
-    r = f * dt_1 / 2.0 + f * (dt_m + t - t_2) +
-      d / 2.0 * (pow(t, 2) + pow(t_2, 2)) - d * t * t_2;
-    *v = f + d * (t - dt_1 - dt_m);
+    tau = t - dt_1 - dt_m;
+    r = (fs + f) / 2.0 * dt_1 + f * dt_m + f * tau + d / 2.0 * pow(tau, 2);
+    *v = f + d * tau;
   }
   else {
-    r = b->prof->l;
-    *v = 0;
+    r = b->prof.l;
+    *v = b->prof.fe;
   }
-  r /= b->prof->l;
+  r /= b->prof.l;
   *v *= 60; // convert to mm/min
-  return r;
+  return MIN(r, 1.0);
 }
 
 // CAREFUL: this function allocates a point
@@ -266,7 +252,7 @@ point_t *block_interpolate(block_t *b, data_t lambda) {
   point_t *result = machine_setpoint(b->machine);
   point_t *p0 = point_zero(b);
 
-  if (b->type == LINE) {
+  if (b->type == LINE || b->type == RAPID) {
     point_set_x(result, point_x(p0) + point_x(b->delta) * lambda);
     point_set_y(result, point_y(p0) + point_y(b->delta) * lambda);
   }
@@ -285,6 +271,103 @@ point_t *block_interpolate(block_t *b, data_t lambda) {
   return result;
 }
 
+// Second derivative of the curvilinear abscissa: the acceleration of the
+// profile phase at time t
+data_t block_acceleration(const block_t *b, data_t t) {
+  assert(b);
+  if (b->prof.l <= 0 || t < 0 || t >= b->prof.dt_1 + b->prof.dt_m + b->prof.dt_2) {
+    return 0;
+  }
+  if (t < b->prof.dt_1) {
+    return b->prof.a;
+  }
+  if (t < b->prof.dt_1 + b->prof.dt_m) {
+    return 0;
+  }
+  return b->prof.d;
+}
+
+// Time derivatives of block_interpolate(): the path tangent (and, on arcs,
+// the curvature) times the speed and acceleration along the profile
+void block_derivatives(const block_t *b, data_t t, data_t v[3], data_t a[3]) {
+  assert(b && v && a);
+  data_t ds, dds, lambda, th, dp[3] = {0}, ddp[3] = {0};
+  data_t l = b->prof.l;
+  int i;
+
+  lambda = block_lambda(b, t, &ds);
+  ds /= 60.0; // back to mm/s
+  dds = block_acceleration(b, t);
+  // first and second derivatives of the position w.r.t. the abscissa
+  if (l > 0 && (b->type == ARC_CW || b->type == ARC_CCW)) {
+    th = b->theta0 + b->dtheta * lambda;
+    dp[0] = -b->r * b->dtheta * sin(th) / l;
+    dp[1] = b->r * b->dtheta * cos(th) / l;
+    dp[2] = point_z(b->delta) / l;
+    ddp[0] = -b->r * pow(b->dtheta / l, 2) * cos(th);
+    ddp[1] = -b->r * pow(b->dtheta / l, 2) * sin(th);
+  }
+  else if (l > 0) {
+    dp[0] = point_x(b->delta) / l;
+    dp[1] = point_y(b->delta) / l;
+    dp[2] = point_z(b->delta) / l;
+  }
+  for (i = 0; i < 3; i++) {
+    v[i] = dp[i] * ds;
+    a[i] = dp[i] * dds + ddp[i] * pow(ds, 2);
+  }
+}
+
+// Highest feed override at time t such that, slowing down at A, the speed
+// is back to the planned one when the cruise phase ends (then the profile
+// accelerates or brakes as planned): with tau the block time left in
+// cruise, k (k - 1) <= tau A / f. 1 outside of the cruise phase
+data_t block_override_limit(const block_t *b, data_t t) {
+  assert(b);
+  data_t tau = b->prof.dt_1 + b->prof.dt_m - t;
+  if (t < b->prof.dt_1 || tau <= 0 || b->prof.f <= 0) {
+    return 1;
+  }
+  return (1 + sqrt(1 + 4 * tau * machine_A(b->machine) / b->prof.f)) / 2;
+}
+
+// Whole block as a parametric segment, workpiece offset included, so that
+// segment_eval() gives the same setpoints as block_lambda() followed by
+// block_interpolate() and machine_sync()
+void block_segment(const block_t *b, coord_t t0, segment_t *s) {
+  assert(b && s);
+  point_t *p0 = point_zero((block_t *)b);
+  point_t *o = machine_offset(b->machine);
+
+  memset(s, 0, sizeof(segment_t));
+  s->n = (uint32_t)b->n;
+  s->type = (b->type == ARC_CW || b->type == ARC_CCW) ? (uint8_t)b->type : SEGMENT_LINE;
+  s->flags = (b->type == RAPID) ? SEGMENT_RAPID : 0;
+  s->t0 = t0;
+  s->p0[0] = point_x(p0) + point_x(o);
+  s->p0[1] = point_y(p0) + point_y(o);
+  s->p0[2] = point_z(p0) + point_z(o);
+  s->delta[0] = point_x(b->delta);
+  s->delta[1] = point_y(b->delta);
+  s->delta[2] = point_z(b->delta);
+  s->center[0] = point_x(b->center) + point_x(o);
+  s->center[1] = point_y(b->center) + point_y(o);
+  s->center[2] = s->p0[2];
+  s->r = b->r;
+  s->theta0 = b->theta0;
+  s->dtheta = b->dtheta;
+  s->l = b->prof.l;
+  s->fs = b->prof.fs;
+  s->f = b->prof.f;
+  s->fe = b->prof.fe;
+  s->a = b->prof.a;
+  s->d = b->prof.d;
+  s->dt_1 = b->prof.dt_1;
+  s->dt_m = b->prof.dt_m;
+  s->dt_2 = b->prof.dt_2;
+  s->dt = b->prof.dt;
+}
+
 
 // GETTERS =====================================================================
 
@@ -293,7 +376,8 @@ typ block_##name(const block_t *b) { assert(b); return b->par; }
 
 block_getter(data_t, length, length);
 block_getter(data_t, dtheta, dtheta);
-block_getter(data_t, prof->dt, dt);
+block_getter(data_t, prof.dt, dt);
+block_getter(data_t, prof.fe, fe);
 block_getter(block_type_t, type, type);
 block_getter(char *, line, line);
 block_getter(size_t, n, n);
@@ -302,6 +386,7 @@ block_getter(point_t *, center, center);
 block_getter(block_t *, next, next);
 block_getter(block_t *, prev, prev);
 block_getter(point_t *, target, target);
+block_getter(point_t *, delta, delta);
 
  
 
@@ -321,136 +406,129 @@ static data_t quantize(data_t t, data_t tq, data_t *dq) {
   return q;
 }
 
-static data_t block_alpha(block_t *b){
-  data_t cos_alpha;
-  data_t v12_x, v12_y , v12_z;
-  data_t v23_x, v23_y , v23_z;
-  data_t dotProduct , magnitudeV12 , magnitudeV23;
-  
-  // if (!b->prev){
-  //   ax = point_x(b->target); 
-  //   ay = point_y(b->target);
-  //   bx = point_x(b->next->target) - point_x(b->target);
-  //   by = point_y(b->next->target) - point_y(b->target);
-  // }else{
-  //   ax = point_x(b->target) - point_x(b->prev->target); 
-  //   ay = point_y(b->target) - point_x(b->prev->target);
-  //   bx = point_x(b->next->target) - point_x(b->target);
-  //   by = point_y(b->next->target) - point_y(b->target);
-// }
-  v12_x = point_x(b->delta);
-  v12_y = point_y(b->delta);
-  v12_z = point_z(b->delta);
-  
-  v23_x = point_x(b->next->delta);
-  v23_y = point_y(b->next->delta);
-  v23_z = point_z(b->next->delta);
-  
-  // dot_prod = (ax*bx) + (ay*by);
-  // cos_alpha = (dot_prod)/(b->length * b->next->length);
-
-  magnitudeV12 = sqrt(v12_x * v12_x + v12_y * v12_y + v12_z * v12_z);
-  magnitudeV23 = sqrt(v23_x * v23_x + v23_y * v23_y + v23_z * v23_z);
-
-  // Calculate dot product
-  dotProduct = v12_x * v23_x + v12_y * v23_y + v12_z * v23_z;
-
-  // Calculate cosine of the angle
-  cos_alpha = dotProduct / (magnitudeV12 * magnitudeV23);
-
-  return cos_alpha;
-}
 // Calcultare the velocity profile
 static void block_compute(block_t *b) {
   assert(b);
-  data_t A, a, d;
-  data_t dt, dt_1, dt_2, dt_m, dq;
-  data_t f_s,f_m, f_e , l;
-  data_t alpha;
-  // data_t l1, l2;
-  // data_t lm;
-
-  A = b->acc;
-  l = b->length;
+  data_t f_s, f_e;
 
-  if(!(b->prev)) {
+  // initial feedrate is the final one of the previous block, if moving
+  if (b->prev && b->prev->type <= ARC_CCW) {
+    f_s = b->prev->prof.fe;
+  }
+  else {
     f_s = 0.0;
-  }else{
-    f_s = b->prev->prof->fe;
   }
+  f_e = b->f_j;
+  profile_compute(&b->prof, b->length, f_s, b->act_feedrate / 60.0, f_e,
+    b->acc, machine_tq(b->machine));
+}
 
-  f_m = b->act_feedrate / 60.0;
-  
-  
-  if(!(b->next)){
-    alpha = 0;
-    f_e = 0;
-  }else{
-    alpha = block_alpha(b);
-    if(f_m != 0){
-      f_e = (f_m + b->next->act_feedrate/60)/2 * alpha;
-    }else{
-      f_e = 0;
-    }
+// Junction feedrate towards the next block (mm/s): the average nominal
+// feedrate scaled by the cosine of the angle between the two blocks, and
+// never more than either of the two feedrates. Corners between a rapid and
+// any other motion are blended instead, with the largest feedrate that keeps
+// the path within rapid_tol of the corner (junction deviation, with the
+// blend arc walked at acceleration A); rapid_tol = 0 stops on every rapid.
+// alpha is the cosine of the angle, NaN if either block has no length.
+static data_t block_junction(const block_t *b, data_t alpha) {
+  data_t f_m = b->act_feedrate / 60.0, f_n, s, tol;
+  if (!b->next || b->type > ARC_CCW || b->next->type > ARC_CCW)
+    return 0.0;
+  f_n = b->next->act_feedrate / 60.0;
+  if (f_m == 0 || f_n == 0 || b->length == 0 || b->next->length == 0)
+    return 0.0;
+  if (isnan(alpha))
+    return 0.0;
+  if (b->type == RAPID || b->next->type == RAPID) {
+    tol = machine_rapid_tol(b->machine);
+    if (tol <= 0)
+      return 0.0;
+    // s = sin of half the angle between the two directions: 1 going
+    // straight on, 0 on a reversal
+    s = sqrt((1.0 + alpha) / 2.0);
+    if (s >= 1.0)
+      return MIN(f_m, f_n);
+    return MIN(sqrt(MIN(b->acc, b->next->acc) * tol * s / (1.0 - s)), MIN(f_m, f_n));
   }
+  if (alpha <= 0)
+    return 0.0;
+  return MIN((f_m + f_n) / 2.0 * alpha, MIN(f_m, f_n));
+}
 
-  dt_1 = (f_m - f_s) / A;
-  dt_2 = (f_m - f_e) / A;
-  if (f_m ==0){
-    dt_m = 0;
-  }else{
-    dt_m = (l/f_m) - (fabs(dt_1) * (f_m + f_s)/(2*f_m)) - (fabs(dt_2) * (f_e + f_m)/(2*f_m));
+// Trapezoidal profile over length l, from feedrate fs to fe through the
+// nominal feedrate f, with acceleration A. All feedrates in mm/s. Each of the
+// two ramps may either accelerate or decelerate, so a and d are signed.
+// If fe is 0, the total time is rounded up to a multiple of tq by lowering
+// the cruise feedrate. If fe cannot be reached within l, it is changed to the closest
+// reachable value (fs is never changed).
+static void profile_compute(block_profile_t *prof, data_t l, data_t fs, data_t f, data_t fe, data_t A, data_t tq) {
+  data_t l_1, l_2, dt_1, dt_2, dt_m, dt, dq, lo, hi;
+  int i;
+
+  memset(prof, 0, sizeof(block_profile_t));
+  prof->l = l;
+  prof->fs = fs;
+  if (l <= 0 || A <= 0 || (f <= 0 && fs <= 0)) {
+    return;
   }
-  
-  if (dt_m > 0) {
-    dt = quantize(fabs(dt_1) + dt_m + fabs(dt_2), machine_tq(b->machine), &dq);
-    dt_m += dq;
-    f_m = ((2 * l) - (f_s * fabs(dt_1)) - (f_e * fabs(dt_2))) / fabs(dt_1 + dt_2 + 2 * dt_m);
-
-    // calculate acceleration --> dt_1 > 0 , dt_2 < 0
-    if (dt_1 > 0){     // a > 0 ,  f_m > f_s
-      a = (f_m - f_s) / dt_1;  
-    }
-
-    if( dt_2 < 0){    // d > 0     f_e > f_m
-      d = (f_m - f_e) / dt_2; 
-    }
-
-    // calculate deceleration --> dt_1 < 0 , dt_2 > 0
-    if (dt_1 < 0){   // a < 0    ,   f_m < f_s
-      a = (f_s - f_m) / dt_1;
-    }
-    if (dt_2 > 0){   // d < 0   ,   f_e < f_m
-      d = (f_e - f_m) / dt_2;
+  // fe must be reachable from fs within l
+  fe = MIN(fe, sqrt(pow(fs, 2) + 2 * A * l));
+  fe = MAX(fe, sqrt(MAX(pow(fs, 2) - 2 * A * l, 0)));
+
+  // long block: ramps and cruise
+  l_1 = fabs(pow(f, 2) - pow(fs, 2)) / (2 * A);
+  l_2 = fabs(pow(f, 2) - pow(fe, 2)) / (2 * A);
+  if (l_1 + l_2 > l) {
+    // short block: no cruise, peak (or valley) feedrate instead
+    if (f > MAX(fs, fe)) f = sqrt((2 * A * l + pow(fs, 2) + pow(fe, 2)) / 2);
+    else f = sqrt(MAX((pow(fs, 2) + pow(fe, 2) - 2 * A * l) / 2, 0));
+    l_1 = fabs(pow(f, 2) - pow(fs, 2)) / (2 * A);
+    l_2 = fabs(pow(f, 2) - pow(fe, 2)) / (2 * A);
+  }
+  dt_1 = fabs(f - fs) / A;
+  dt_2 = fabs(f - fe) / A;
+  dt_m = f > 0 ? MAX(l - l_1 - l_2, 0) / f : 0;
+
+  // blocks ending with a full stop are quantized, so that the last sample
+  // falls on the target: keep both ramps at acceleration A and lower the
+  // cruise feedrate so that l is covered in the rounded up time. The covered
+  // length grows with f, so that the new f can be found by bisection between
+  // the current one and the lowest one whose ramps still fit in dt.
+  // Blocks joined to the next one keep their exact duration (rounding it
+  // might not be feasible without exceeding A), and the FSM carries the
+  // time past their end into the next block.
+  dt = dt_1 + dt_m + dt_2;
+  if (fe == 0) {
+    dt = quantize(dt, tq, &dq);
+    lo = MAX((fs - A * dt) / 2.0, 0);
+    hi = f;
+    for (i = 0; i < 64; i++) {
+      f = (lo + hi) / 2.0;
+      if (profile_length(f, fs, fe, A, dt) > l) hi = f;
+      else lo = f;
     }
+    dt_1 = fabs(f - fs) / A;
+    dt_2 = f / A;
+    dt_m = MAX(dt - dt_1 - dt_2, 0);
+  }
 
-  }else{   // short segmentation
-    dt_1 = sqrt(l/A);
-    dt_2 = dt_1;
-    dt = quantize(dt_1 + dt_2, machine_tq(b->machine), &dq);
-      dt_m = 0;
-      dt_2 += dq;
-      f_m = 2 * l / (dt_1 + dt_2);
+  prof->dt_1 = dt_1;
+  prof->dt_m = dt_m;
+  prof->dt_2 = dt_2;
+  prof->dt = dt;
+  prof->a = dt_1 > 0 ? (f - fs) / dt_1 : 0;
+  prof->d = dt_2 > 0 ? (fe - f) / dt_2 : 0;
+  prof->f = f;
+  prof->fe = fe;
+}
 
-      a = (f_m - f_s)/dt_1;
-      d = (f_e - f_m)/dt_2;
 
-  }
-  
-  // set calculated values in block object
-  b->prof->dt_1 = dt_1;
-  b->prof->dt_2 = dt_2;
-  b->prof->dt_m = dt_m;
-  b->prof->a = a;
-  b->prof->d = d;
-  b->prof->f = f_m;
-  b->prof->dt = dt;
-  b->prof->l = l;
-  b->prof->fe = f_e;
-  b->prof->fs = f_s;
+// Length covered in time dt ramping at acceleration A from fs to f, cruising,
+// then ramping to fe (ramps must fit in dt)
+static data_t profile_length(data_t f, data_t fs, data_t fe, data_t A, data_t dt) {
+  return f * dt - (f - fs) * fabs(f - fs) / (2 * A) - (f - fe) * fabs(f - fe) / (2 * A);
 }
 
-
 // static void block_compute_new(block_t *b){
 //   assert(b);
 //   data_t f_s , f_m , f_e;
@@ -487,95 +565,10 @@ static void block_compute(block_t *b) {
 // 
 // }
 
-static int block_velocity(block_t *b){
-  assert(b);
-  data_t f_s , f_m , f_e;
-  data_t alpha;
-
-
-  A = b->acc;
-  l = b->length;
-
-  if(!(b->prev)) {
-    f_s = 0.0;
-  }else{
-    f_s = b->prev->prof->fs;
-  }
-
-  f_m = b->act_feedrate / 60.0;
-  
-  
-  if(!(b->next)){
-    alpha = 0;
-    f_e = 0;
-  }else{
-    alpha = block_alpha(b);
-    if(f_m != 0){
-      f_e = (f_m + b->next->act_feedrate/60)/2 * alpha;
-    }else{
-      f_e = 0;
-    }
-  }
-
-  b->prof->fs = f_s;
-  b->prof->fe = f_e;
-  b->prof->f = f_m;
-  b->prof->alpha = alpha;
-
-}
-
-static void block_acc(block_t *b){
-  assert(b);
-  data_t A , l , a , d , l1 , l2;
-  data_t f_s , f_e , f_m , f;
-  data_t t1 , t2 , t_m;
-
-  f_s = b->prof->fs;
-  f_e = b->prof->fe;
-  f_m = b->act_feedrate;
-  A = b->acc;
-  l = b->length;
-
-  l1 = (f_m - f_s)/(2*A);
-  l2 = (f_e - f_m)/(2*A);
-  
-  if (l-abs(l1)-asb(l2) > 0){   // long segmentation
-    f_m = sqrt(2*A*l1 + pow(f_s , 2));
-    
-  }else{ // short segmentation 
-    f_m = sqrt((2 * A * l) + (pow(f_s,2) + pow(f_e,2)) / 2)
-    l1 = (f_m - f_s)/(2*A);
-    l2 = (f_e - f_m)/(2*A);
-  }
-
-  a = (f_m - f_s)/(2*abs(l1));
-  d = (f_e - f_m)/(2*abs(l2));
-
-  t1 = abs((f_m - f_s)/(a));
-  
-  
-  b->prof->a = a;
-  b->prof->d = d;
-  b->prof->f = f_m;
-}
-static void block_time(block_t *b){
-  assert(b);
-  data_t A , l , a , d , l1 , l2;
-  data_t f_s , f_e , f_m , f;
-  data_t t1 , t2 , t_m;
-
-  a = b->prof->a;
-  d = b->prof->d;
-
-
-  if (a > 0){
-
-  }
-}
-
 // Calculate the arc coordinates
 static int block_arc(block_t *b) {
-  data_t x0, y0, z0, xc, yc, xf, yf, zf, r;
+  coord_t x0, y0, z0, xc, yc, xf, yf, zf;
+  data_t r;
   point_t *p0 = point_zero(b);
   x0 = point_x(p0);
   y0 = point_y(p0);
@@ -606,7 +599,7 @@ static int block_arc(block_t *b) {
     xc = x0 + b->i;
     yc = y0 + b->j;
     r2 = hypot(xf - xc, yf - yc);
-    if (fabs(r - r2) > machine_error(b->machine)) {
+    if (fabs(r - r2) > machine_max_error(b->machine)) {
       fprintf(stderr, "Arc endpoints mismatch error (%f)\n", r - r2);
       return 1;
     }
@@ -727,6 +720,18 @@ int main() {
 //
 // Implement here block-related functions for look-ahead
 
+// Junction feedrate towards the next block, lowered so that the next block
+// can always slow down to its own junction feedrate within its length.
+// Must be called from the last block backwards, so that the program can
+// always stop at its end
+void block_lookahead(block_t *b, data_t alpha) {
+  assert(b);
+  block_t *n = b->next;
+  b->f_j = block_junction(b, alpha);
+  if (n && n->type <= ARC_CCW) {
+    b->f_j = MIN(b->f_j, sqrt(pow(n->f_j, 2) + 2 * n->acc * n->length));
+  }
+}
 
 
 // int block_parse_partial(block_t *b) {
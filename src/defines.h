@@ -20,7 +20,25 @@
 #include <assert.h>
 #include <string.h>
 
+// Numeric precision, from the DATA_TYPE option in CMakeLists.txt:
+//   coord_t: absolute quantities, which grow along a program: machine
+//            coordinates (mm) and the program clock (s)
+//   data_t:  everything else: quantities relative to a block (deltas,
+//            lengths, profile parameters, lambda), feeds, gains, errors
+// double: both double; float: both float; mixed: double coordinates and
+// float block quantities
+#define DATA_TYPE "double"
+#define DATA_TYPE_double
+#if defined(DATA_TYPE_float)
+typedef float coord_t;
+typedef float data_t;
+#elif defined(DATA_TYPE_mixed)
+typedef double coord_t;
+typedef float data_t;
+#else
+typedef double coord_t;
 typedef double data_t;
+#endif
 
 // Cmake-generated values:
 #define VERSION "1.0"
@@ -29,5 +47,7 @@ typedef double data_t;
 #define eprintf(...) fprintf(stderr, __VA_ARGS__)
 
 uint64_t wait_next(uint64_t interval);
+uint64_t wait_next_r(uint64_t interval, uint64_t *last_call);
+uint64_t now_ns(void);
 
 #endif
@@ -0,0 +1,142 @@
+//   _____     _   _                 _
+//  | ____|___| |_(_)_ __ ___   __ _| |_ ___  _ __
+//  |  _| / __| __| | '_ ` _ \ / _` | __/ _ \| '__|
+//  | |___\__ \ |_| | | | | | | (_| | || (_) | |
+//  |_____|___/\__|_|_| |_| |_|\__,_|\__\___/|_|
+
+#include "estimator.h"
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+#define EST_HIST 1024           // commanded setpoints kept, by seq
+#define EST_RTT_GAIN 0.01       // rise rate of the round trip envelope
+#define EST_HORIZON 0.1         // s, max extrapolation of the following error
+
+typedef struct {
+  uint32_t seq;
+  uint64_t t;                   // time sent (ns)
+  coord_t sp[3];
+} est_command_t;
+
+typedef struct estimator {
+  data_t alpha, beta;           // filter gains
+  est_command_t hist[EST_HIST]; // commanded setpoints, by seq
+  uint32_t last;                // seq of the last commanded setpoint
+  int commanded;                // 1 once a setpoint is recorded
+  int valid;                    // 1 once a sample is fused
+  data_t e[3], de[3];           // following error (mm) and its rate (mm/s)
+  uint64_t t_e;                 // time of the setpoint e refers to (ns)
+  data_t rtt;                   // lower envelope of the round trip (s)
+} estimator_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+estimator_t *estimator_new(data_t alpha, data_t beta) {
+  estimator_t *e;
+  if (alpha <= 0 || alpha > 1 || beta < 0 || beta > 1) {
+    eprintf("Wrong estimator gains (alpha %g, beta %g)\n", alpha, beta);
+    return NULL;
+  }
+  e = (estimator_t *)calloc(1, sizeof(estimator_t));
+  if (!e) {
+    perror("Error creating estimator object");
+    exit(EXIT_FAILURE);
+  }
+  e->alpha = alpha;
+  e->beta = beta;
+  return e;
+}
+
+void estimator_free(estimator_t *e) {
+  assert(e);
+  free(e);
+}
+
+// ALGORITHMS ==================================================================
+
+void estimator_command(estimator_t *e, uint32_t seq, uint64_t t, const coord_t sp[3]) {
+  assert(e && sp);
+  est_command_t *c = &e->hist[seq % EST_HIST];
+  c->seq = seq;
+  c->t = t;
+  memcpy(c->sp, sp, sizeof(c->sp));
+  e->last = seq;
+  e->commanded = 1;
+}
+
+// The sample is compared with the following error predicted at the time
+// its setpoint was sent: the samples arrive late, but in the time frame of
+// the commands they are on time, and dt is the spacing of the setpoints
+int estimator_correct(estimator_t *e, uint32_t seq, uint64_t t, const coord_t pos[3], uint64_t now) {
+  assert(e && pos);
+  const est_command_t *c = &e->hist[seq % EST_HIST];
+  data_t dt, ep, r;
+  int i;
+
+  if (!e->commanded || c->seq != seq || c->t != t || t > now) return 1;
+  if (!e->valid) {
+    for (i = 0; i < 3; i++) {
+      e->e[i] = pos[i] - c->sp[i];
+      e->de[i] = 0;
+    }
+    e->rtt = (now - t) / 1E9;
+    e->t_e = t;
+    e->valid = 1;
+    return 0;
+  }
+  // older than the last fused one
+  if (t < e->t_e) return 1;
+  dt = (t - e->t_e) / 1E9;
+  for (i = 0; i < 3; i++) {
+    ep = e->e[i] + e->de[i] * dt;
+    r = pos[i] - c->sp[i] - ep;
+    e->e[i] = ep + e->alpha * r;
+    if (dt > 0) e->de[i] += e->beta * r / dt;
+  }
+  // the delays above the lowest ones are mostly spent waiting for the
+  // control loop to read the feedback, not on the way to the plant
+  r = (now - t) / 1E9;
+  e->rtt = r < e->rtt ? r : e->rtt + EST_RTT_GAIN * (r - e->rtt);
+  e->t_e = t;
+  return 0;
+}
+
+data_t estimator_predict(const estimator_t *e, uint64_t now, coord_t pos[3]) {
+  assert(e && pos);
+  const est_command_t *c = &e->hist[e->last % EST_HIST];
+  uint64_t t_a = now - (uint64_t)(e->rtt / 2 * 1E9);
+  uint32_t seq = e->last;
+  data_t h, err, d = 0;
+  int i;
+
+  // the setpoint being applied now, sent half a round trip ago (or the
+  // oldest one recorded)
+  for (i = 0; i < EST_HIST - 1 && c->t > t_a; i++) {
+    const est_command_t *prev = &e->hist[(seq - 1) % EST_HIST];
+    if (prev->seq != seq - 1) break;
+    c = prev;
+    seq--;
+  }
+  h = t_a > e->t_e ? MIN((t_a - e->t_e) / 1E9, EST_HORIZON) : 0;
+  for (i = 0; i < 3; i++) {
+    err = e->e[i] + e->de[i] * h;
+    pos[i] = c->sp[i] + err;
+    d += err * err;
+  }
+  return sqrt(d);
+}
+
+// ACCESSORS ===================================================================
+
+int estimator_valid(const estimator_t *e) { assert(e); return e->valid; }
+data_t estimator_rtt(const estimator_t *e) { assert(e); return e->rtt; }
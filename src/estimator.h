@@ -0,0 +1,70 @@
+//   _____     _   _                 _
+//  | ____|___| |_(_)_ __ ___   __ _| |_ ___  _ __
+//  |  _| / __| __| | '_ ` _ \ / _` | __/ _ \| '__|
+//  | |___\__ \ |_| | | | | | | (_| | || (_) | |
+//  |_____|___/\__|_|_| |_| |_|\__,_|\__\___/|_|
+//  Position estimator: between feedback messages, and for the time they
+//  take to arrive, the machine position is predicted from the commanded
+//  setpoints. The plant echoes the sequence number of the last setpoint it
+//  applied with its position, so that each sample is compared with the
+//  setpoint it answers, whatever the delay. The model is that each axis
+//  follows the setpoints with a slowly varying following error, which an
+//  alpha-beta filter tracks (value and rate) across samples. The position
+//  now is the setpoint being applied now (sent half a round trip ago, taking
+//  the lowest round trips) plus the following error extrapolated to that
+//  time.
+//  Times are in ns, as stamped by now_ns().
+
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include "defines.h"
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque struct
+typedef struct estimator estimator_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+// Filter gains: alpha for the following error, in (0, 1], and beta for its
+// rate, in [0, 1] (0 leaves the rate at zero, holding the error between
+// samples); higher values trust the samples more than the model
+estimator_t *estimator_new(data_t alpha, data_t beta);
+void estimator_free(estimator_t *e);
+
+// ALGORITHMS ==================================================================
+
+// Record setpoint seq, sent at time t
+void estimator_command(estimator_t *e, uint32_t seq, uint64_t t, const coord_t sp[3]);
+
+// Fuse a position sample reported on setpoint seq, sent at time t, and
+// received at time now; return value is 1 if seq is no longer (or was
+// never) recorded, and the sample is discarded
+int estimator_correct(estimator_t *e, uint32_t seq, uint64_t t, const coord_t pos[3], uint64_t now);
+
+// Latency-compensated position at time now; return value is the estimated
+// positioning error at the same time (distance from the setpoint being
+// applied). Not valid until the first sample is fused
+data_t estimator_predict(const estimator_t *e, uint64_t now, coord_t pos[3]);
+
+// ACCESSORS ===================================================================
+
+// 1 once a sample has been fused
+int estimator_valid(const estimator_t *e);
+
+// Round trip time (s), lower envelope
+data_t estimator_rtt(const estimator_t *e);
+
+#endif // ESTIMATOR_H
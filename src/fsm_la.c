@@ -18,19 +18,49 @@ Functions and types have been generated with prefix "ccnc_"
 #include "point.h"
 #include <unistd.h>
 #include <termios.h>
+#include <ctype.h>
 
 // Install signal handler: 
 // SIGINT requests a transition to state stop
+// The handler only counts signals; each FSM instance latches the count into
+// its own exit_request (see exit_requested()), so that several machines can
+// live in the same process. The handler is installed by the first instance
+// and removed by the last one.
 #include <signal.h>
-static int _exit_request = 0;
+#include <stdatomic.h>
+static volatile sig_atomic_t _sigint_count = 0;
+static atomic_int _instances = 0;
 static void signal_handler(int signal) {
   if (signal == SIGINT) {
-    _exit_request = 1;
+    _sigint_count++;
   }
 }
 
+// Latch any SIGINT received since the last call into this instance; the
+// return value counts the requests
+static int exit_requested(ccnc_state_data_t *data) {
+  sig_atomic_t count = _sigint_count;
+  if (count != data->sigint_seen) {
+    data->exit_request += count - data->sigint_seen;
+    data->sigint_seen = count;
+  }
+  return data->exit_request;
+}
+
+// Trajectory output, stdout unless set per instance
+#define OUT(data) ((data)->out ? (data)->out : stdout)
+
 // SEARCH FOR Your Code Here FOR CODE INSERTION POINTS!
 
+static ccnc_state_t idle_headless(ccnc_state_data_t *data);
+static int poll_commands(ccnc_state_data_t *data);
+static int motion_exit(ccnc_state_data_t *data);
+static int motion_begin(ccnc_state_data_t *data, int rapid);
+static int motion_step(ccnc_state_data_t *data, int rapid);
+static int block_over(ccnc_state_data_t *data, data_t dt, data_t step, int stop);
+static int block_covered(ccnc_state_data_t *data, block_t *b);
+static void stream_segment(ccnc_state_data_t *data);
+
 // GLOBALS
 // State human-readable names
 const char *ccnc_state_names[] = {"init", "idle", "stop", "load_block", "no_motion", "rapid_motion", "interp_motion"};
@@ -52,7 +82,7 @@ transition_func_t *const ccnc_transition_table[CCNC_NUM_STATES][CCNC_NUM_STATES]
   /* init          */ {NULL             , NULL             , NULL             , NULL             , NULL             , NULL             , NULL             }, 
   /* idle          */ {NULL             , NULL             , NULL             , ccnc_reset       , NULL             , NULL             , NULL             }, 
   /* stop          */ {NULL             , NULL             , NULL             , NULL             , NULL             , NULL             , NULL             }, 
-  /* load_block    */ {NULL             , NULL             , NULL             , NULL             , NULL             , ccnc_begin_rapid , ccnc_begin_interp}, 
+  /* load_block    */ {NULL             , NULL             , NULL             , NULL             , NULL             , NULL             , NULL             }, 
   /* no_motion     */ {NULL             , NULL             , NULL             , NULL             , NULL             , NULL             , NULL             }, 
   /* rapid_motion  */ {NULL             , NULL             , NULL             , ccnc_end_rapid   , NULL             , NULL             , NULL             }, 
   /* interp_motion */ {NULL             , NULL             , NULL             , NULL             , NULL             , NULL             , NULL             }, 
@@ -76,7 +106,10 @@ transition_func_t *const ccnc_transition_table[CCNC_NUM_STATES][CCNC_NUM_STATES]
 ccnc_state_t ccnc_do_init(ccnc_state_data_t *data) {
   ccnc_state_t next_state = CCNC_STATE_IDLE;
   point_t *sp, *zero;
-  signal(SIGINT, signal_handler); 
+  data->sigint_seen = _sigint_count;
+  if (atomic_fetch_add(&_instances, 1) == 0) {
+    signal(SIGINT, signal_handler);
+  }
   
   // Steps:
   // * in case of errors, transition to stop
@@ -93,6 +126,33 @@ ccnc_state_t ccnc_do_init(ccnc_state_data_t *data) {
     next_state = CCNC_STATE_STOP;
     goto next_state;
   }
+  // * feed override, adaptive if configured
+  data->ovr = override_new(data->ini_file);
+  if (!data->ovr) {
+    next_state = CCNC_STATE_STOP;
+    goto next_state;
+  }
+
+  // * headless: programs are parsed by the job queue, in background
+  // * simulation: the same, but runs the given program straight away
+  if (data->headless || machine_headless(data->machine) ||
+      machine_simulate(data->machine)) {
+    data->jobs = jobs_new(data->machine);
+    if (!data->jobs) {
+      next_state = CCNC_STATE_STOP;
+      goto next_state;
+    }
+    if (data->prog_file) {
+      jobs_push(data->jobs, data->prog_file);
+    }
+    if (machine_simulate(data->machine)) {
+      data->run_jobs = data->batch = 1;
+    }
+    else {
+      eprintf("Headless mode, waiting for commands\n");
+    }
+    goto set_zero;
+  }
 
   // * load and parse the G-code file
   data->prog = program_new(data->prog_file);
@@ -115,6 +175,7 @@ ccnc_state_t ccnc_do_init(ccnc_state_data_t *data) {
   eprintf("Parsed the program %s\n", data->prog_file);
   program_print(data->prog, stderr);
 
+set_zero:
   sp = machine_setpoint(data->machine);
   zero = machine_zero(data->machine);
   point_set_x(sp, point_x(zero));
@@ -147,6 +208,12 @@ ccnc_state_t ccnc_do_idle(ccnc_state_data_t *data) {
   // if q is pressed, switch to stop
   // * if spacebar is pressed, switch to load_block
   // * reset total timer
+  if (data->jobs) {
+    // headless: no terminal, commands come from the machine
+    machine_listen_update(data->machine);
+    next_state = idle_headless(data);
+    goto next_state;
+  }
   eprintf("Press spacebar or 'r' to run, 'q' to quit\n");
   // save current terminal settings
   tcgetattr(STDIN_FILENO, &old_tio);
@@ -172,9 +239,10 @@ ccnc_state_t ccnc_do_idle(ccnc_state_data_t *data) {
   default:
     break;
   }
+  machine_listen_update(data->machine);
+next_state:
   data->t_blk = 0;
   data->t_tot = 0;
-  machine_listen_update(data->machine);
   
   switch (next_state) {
     case CCNC_NO_CHANGE:
@@ -187,7 +255,7 @@ ccnc_state_t ccnc_do_idle(ccnc_state_data_t *data) {
   }
   
   // SIGINT transition override
-  if (_exit_request) next_state = CCNC_STATE_STOP;
+  if (exit_requested(data)) next_state = CCNC_STATE_STOP;
   
   return next_state;
 }
@@ -202,7 +270,9 @@ ccnc_state_t ccnc_do_stop(ccnc_state_data_t *data) {
   // * disconnect machine
   // * free resources
   eprintf("Clean up...");
-  signal(SIGINT, SIG_DFL);
+  if (atomic_fetch_sub(&_instances, 1) == 1) {
+    signal(SIGINT, SIG_DFL);
+  }
   if (data->machine) {
     machine_disconnect(data->machine);
     machine_free(data->machine);
@@ -210,6 +280,12 @@ ccnc_state_t ccnc_do_stop(ccnc_state_data_t *data) {
   if (data->prog) {
     program_free(data->prog);
   }
+  if (data->jobs) {
+    jobs_free(data->jobs);
+  }
+  if (data->ovr) {
+    override_free(data->ovr);
+  }
   eprintf(" done.\n");
   
   switch (next_state) {
@@ -224,14 +300,23 @@ ccnc_state_t ccnc_do_stop(ccnc_state_data_t *data) {
 
 
 // Function to be executed in state load_block
-// valid return states: CCNC_STATE_IDLE, CCNC_STATE_NO_MOTION, CCNC_STATE_RAPID_MOTION, CCNC_STATE_INTERP_MOTION
+// valid return states: CCNC_STATE_IDLE, CCNC_STATE_LOAD_BLOCK, CCNC_STATE_NO_MOTION, CCNC_STATE_RAPID_MOTION, CCNC_STATE_INTERP_MOTION
 ccnc_state_t ccnc_do_load_block(ccnc_state_data_t *data) {
   ccnc_state_t next_state = CCNC_STATE_IDLE;
   
   // Steps:
-  // * load next block/
+  // * load next block, passing over those already covered by the time
+  //   carried into them
+  // * start motion blocks, sending their first setpoint in this same tick
+  // * a block already completed by that setpoint is over: load the next one
+  //   on the following tick
   block_t *b = program_next(data->prog);
+  while (b && block_covered(data, b)) {
+    block_print(b, stderr);
+    b = program_next(data->prog);
+  }
   if (!b) {
+    eprintf("Program %s completed, cycle time %.3f s\n", program_filename(data->prog), data->t_tot);
     next_state = CCNC_STATE_IDLE;
     goto next_state;
   }
@@ -253,9 +338,14 @@ ccnc_state_t ccnc_do_load_block(ccnc_state_data_t *data) {
     next_state = CCNC_STATE_IDLE;
     break;
   }
+  if (next_state == CCNC_STATE_RAPID_MOTION || next_state == CCNC_STATE_INTERP_MOTION) {
+    if (motion_begin(data, next_state == CCNC_STATE_RAPID_MOTION))
+      next_state = CCNC_STATE_LOAD_BLOCK;
+  }
 next_state:
   switch (next_state) {
     case CCNC_STATE_IDLE:
+    case CCNC_STATE_LOAD_BLOCK:
     case CCNC_STATE_NO_MOTION:
     case CCNC_STATE_RAPID_MOTION:
     case CCNC_STATE_INTERP_MOTION:
@@ -292,19 +382,14 @@ ccnc_state_t ccnc_do_no_motion(ccnc_state_data_t *data) {
 // SIGINT triggers an emergency transition to stop
 ccnc_state_t ccnc_do_rapid_motion(ccnc_state_data_t *data) {
   ccnc_state_t next_state = CCNC_NO_CHANGE;
-  data_t tq = machine_tq(data->machine);
   // Steps:
-  // * call machine_listen_update()
-  // * update times (block and total)
-  // * if error below threshold, transition to load_block
-  machine_listen_update(data->machine);
-  data->t_blk += tq;
-  data->t_tot += tq;
-  if (machine_error(data->machine) < machine_max_error(data->machine)) {
-    next_state = CCNC_STATE_LOAD_BLOCK;
-  }
-  if (_exit_request) {
-    _exit_request = 0;
+  // * interpolate position, as for feed moves (rapid axes are synchronized
+  //   by the planner); rapids ending with a full stop then hold the target
+  //   for the planned settling time
+  // * when done, transition to load_block
+  // * feed override commands act at once
+  if (poll_commands(data)) data->exit_request++;
+  if (motion_step(data, 1)) {
     next_state = CCNC_STATE_LOAD_BLOCK;
   }
 
@@ -317,8 +402,8 @@ ccnc_state_t ccnc_do_rapid_motion(ccnc_state_data_t *data) {
       next_state = CCNC_NO_CHANGE;
   }
   
-  // SIGINT transition override
-  if (_exit_request) next_state = CCNC_STATE_STOP;
+  // SIGINT transition override, once at rest
+  if (motion_exit(data)) next_state = CCNC_STATE_STOP;
   
   return next_state;
 }
@@ -329,32 +414,18 @@ ccnc_state_t ccnc_do_rapid_motion(ccnc_state_data_t *data) {
 // SIGINT triggers an emergency transition to stop
 ccnc_state_t ccnc_do_interp_motion(ccnc_state_data_t *data) {
   ccnc_state_t next_state = CCNC_NO_CHANGE;
-  data_t tq = machine_tq(data->machine);
-  data_t lambda, feed;
-  block_t *b = program_current(data->prog);
-  point_t *sp;
 
   // Steps:
   // * calculate lambda
   // * interpolate position
   // * update times
   // * if lambda >= 1 transition to load_block
-  data->t_blk += tq;
-  data->t_tot += tq;
-  if (data->t_blk >= block_dt(b) + tq / 2.0) {
+  // * feed override commands act at once
+  if (poll_commands(data)) data->exit_request++;
+  if (motion_step(data, 0)) {
     next_state = CCNC_STATE_LOAD_BLOCK;
-    goto next_block;
   }
-  lambda = block_lambda(b, data->t_blk, &feed);
-  sp = block_interpolate(b, lambda);
-  if (!sp) {
-    next_state = CCNC_STATE_LOAD_BLOCK;
-    goto next_block;
-  }
-  printf("%lu,%f,%f,%f,%f,%f,%f,%f,%f\n", block_n(b), data->t_tot, data->t_blk, lambda, lambda * block_length(b), feed, point_x(sp), point_y(sp), point_z(sp));
-  machine_sync(data->machine, 0);
 
-next_block:
   switch (next_state) {
     case CCNC_NO_CHANGE:
     case CCNC_STATE_LOAD_BLOCK:
@@ -364,8 +435,8 @@ next_block:
       next_state = CCNC_NO_CHANGE;
   }
   
-  // SIGINT transition override
-  if (_exit_request) next_state = CCNC_STATE_STOP;
+  // SIGINT transition override, once at rest
+  if (motion_exit(data)) next_state = CCNC_STATE_STOP;
   
   return next_state;
 }
@@ -389,35 +460,9 @@ next_block:
 void ccnc_reset(ccnc_state_data_t *data) {
   // Steps:
   // reset both timers
-  data->t_blk = data->t_tot = 0;
-  printf("n,t_tot,t_blk,lambda,s,feed,x,y,z\n");
-}
-
-// This function is called in 1 transition:
-// 1. from load_block to rapid_motion
-void ccnc_begin_rapid(ccnc_state_data_t *data) {
-  point_t *sp = machine_setpoint(data->machine);
-  block_t *b = program_current(data->prog);
-  point_t *target = block_target(b);
-  // Steps:
-  // * reset block timer
-  // * set final position as set point and use machine_sync
-  // * call machine_listen_start()
-  machine_listen_start(data->machine);
-  data->t_blk = 0;
-  // copy target coordinates into setpoint
-  point_set_x(sp, point_x(target));
-  point_set_y(sp, point_y(target));
-  point_set_z(sp, point_z(target));
-  machine_sync(data->machine, 1);
-}
-
-// This function is called in 1 transition:
-// 1. from load_block to interp_motion
-void ccnc_begin_interp(ccnc_state_data_t *data) {
-  // Steps:
-  // reset block timer
-  data->t_blk = 0;
+  data->t_blk = data->t_tot = data->t_carry = data->step = 0;
+  override_reset(data->ovr);
+  fprintf(OUT(data), "n,t_tot,t_blk,lambda,s,feed,x,y,z\n");
 }
 
 // This function is called in 1 transition:
@@ -428,6 +473,233 @@ void ccnc_end_rapid(ccnc_state_data_t *data) {
   machine_listen_stop(data->machine);
 }
 
+// First tick of a motion block, in the load state: reset the block timer to
+// the time carried over from the previous block, send the whole block as a
+// segment, if streaming segments, and send the first setpoint, so that there
+// is no gap after the previous block. Returns 1 if that setpoint already
+// completed the block
+static int motion_begin(ccnc_state_data_t *data, int rapid) {
+  if (rapid) machine_listen_start(data->machine);
+  data->t_blk = data->t_carry;
+  data->t_carry = 0;
+  stream_segment(data);
+  if (!motion_step(data, rapid)) return 0;
+  if (rapid) machine_listen_stop(data->machine);
+  return 1;
+}
+
+// One tick of a motion block: update times, interpolate and send the
+// setpoint. Returns 1 once the block is over, so that the next block starts
+// on the following tick (the load and the first sample of the next block
+// share a tick, see motion_begin()). A block joined to the next one at
+// non-zero feedrate is over when the next sample would fall past its end,
+// and that time is carried into the next block, for such blocks do not last
+// a whole number of ticks: blocks shorter than the time carried into them
+// are passed over at load (see block_covered()), and the others are always
+// sampled, at their end if the step has grown since. A block ending with a
+// full stop is over once a sample has reached its target, plus the settling
+// time for rapids (less, if the position estimate shows the machine on
+// target sooner).
+// The block timer runs at the feed override rate: each tick advances it by
+// k*tq, with k from the override (1 when streaming segments, for the plant
+// then runs the profile on its own clock). During a feed hold k reaches 0,
+// and the same setpoint is sent until the hold is released.
+static int motion_step(ccnc_state_data_t *data, int rapid) {
+  data_t tq = machine_tq(data->machine);
+  data_t lambda, feed, dt, k = 1, step;
+  block_t *b = program_current(data->prog);
+  int stop = (block_fe(b) == 0);
+  point_t *sp;
+
+  dt = block_dt(b);
+  // the settling time is cut short once the estimated position is on target
+  if (rapid && stop && !(data->t_blk >= dt - tq / 1000.0 && machine_settled(data->machine))) {
+    dt += machine_rapid_settle(data->machine);
+  }
+  // flow control: hold on while the plant buffer is full
+  data->credit = machine_credit(data->machine);
+  if (data->credit == 0) {
+    return 0;
+  }
+  // rapids are never sped up
+  if (!machine_segments(data->machine)) {
+    block_lambda(b, data->t_blk, &feed);
+    k = override_update(data->ovr, machine_error_est(data->machine), feed / 60.0,
+      block_acceleration(b, data->t_blk),
+      rapid ? 1 : block_override_limit(b, data->t_blk), tq);
+  }
+  step = k * tq;
+  data->step = step;
+  // full stop block already on target (rapids: done settling)
+  if (stop && block_over(data, dt, step, stop)) {
+    return 1;
+  }
+  data->t_blk += step;
+  data->t_tot += tq;
+  // past block_dt(), lambda stays at 1
+  lambda = block_lambda(b, data->t_blk, &feed);
+  feed *= k;
+  sp = block_interpolate(b, lambda);
+  if (!sp) {
+    data->t_carry = 0;
+    return 1;
+  }
+  data->lambda = lambda;
+  data->feed = feed;
+  if (machine_feed_forward(data->machine)) {
+    data_t v[3], a[3];
+    int i;
+    block_derivatives(b, data->t_blk, v, a);
+    for (i = 0; i < 3; i++) {
+      v[i] *= k;
+      a[i] *= k * k;
+    }
+    machine_set_derivatives(data->machine, v, a);
+  }
+  fprintf(OUT(data), "%lu,%f,%f,%f,%f,%f,%f,%f,%f\n", block_n(b), data->t_tot, data->t_blk, lambda, lambda * block_length(b), feed, point_x(sp), point_y(sp), point_z(sp));
+  machine_sync(data->machine, rapid);
+  data->setpoints++;
+  // the setpoint just sent takes up a slot
+  if (data->credit > 0) data->credit--;
+  data->credit_tick = 1;
+  return block_over(data, dt, step, stop);
+}
+
+// End of block test for motion_step(), also setting the time carried over;
+// step is the block time of the next tick
+static int block_over(ccnc_state_data_t *data, data_t dt, data_t step, int stop) {
+  data_t eps = machine_tq(data->machine) / 1000.0;
+  if (stop) {
+    data->t_carry = 0;
+    return data->t_blk >= dt - eps;
+  }
+  data->t_carry = data->t_blk - dt;
+  return data->t_blk + step > dt + eps;
+}
+
+// Joined motion blocks that end before the first sample the time carried
+// into them would take are passed over, with their time carried on: were
+// they loaded, their tick would send no setpoint. Streamed segments are sent
+// all the same, for the plant samples them on its own
+static int block_covered(ccnc_state_data_t *data, block_t *b) {
+  data_t eps = machine_tq(data->machine) / 1000.0;
+  if (block_type(b) > ARC_CCW || block_fe(b) == 0) return 0;
+  if (data->t_carry + data->step <= block_dt(b) + eps) return 0;
+  data->t_blk = data->t_carry;
+  stream_segment(data);
+  data->t_carry -= block_dt(b);
+  return 1;
+}
+
+int ccnc_credit(ccnc_state_data_t *data) {
+  if (!data->credit_tick) return 0;
+  data->credit_tick = 0;
+  return data->credit;
+}
+
+// Segment streaming: the block starts t_blk before the current tick, and the
+// plant interpolates it on its own clock
+static void stream_segment(ccnc_state_data_t *data) {
+  segment_t seg;
+  if (!machine_segments(data->machine)) return;
+  block_segment(program_current(data->prog), data->t_tot - data->t_blk, &seg);
+  machine_stream(data->machine, &seg);
+}
+
+// Process the pending commands; return value is 1 if asked to quit.
+// Commands are:
+//   queue <file>  append a G-code file to the job queue (headless only)
+//   start         run the queued jobs back to back
+//   stop          do not start further jobs (the running one completes)
+//   quit          terminate the controller (braking first, if moving)
+//   feed <pct>    feed override, 0-200% of the programmed feed
+//   hold          feed hold: brake along the path, at A
+//   resume        release the feed hold
+// The job commands only matter between jobs; the others act at once.
+static int poll_commands(ccnc_state_data_t *data) {
+  char cmd[MACHINE_CMD_LEN];
+  size_t len;
+  int quit = 0;
+  while (machine_command(data->machine, cmd) == 0) {
+    // strip trailing newlines and spaces
+    len = strlen(cmd);
+    while (len > 0 && isspace((unsigned char)cmd[len - 1])) cmd[--len] = '\0';
+    if (strncmp(cmd, "queue ", 6) == 0) {
+      if (!data->jobs)
+        eprintf("Jobs can only be queued in headless mode\n");
+      else if (jobs_push(data->jobs, cmd + 6) == 0)
+        eprintf("Queued job %s\n", cmd + 6);
+    }
+    else if (strcmp(cmd, "start") == 0) {
+      data->run_jobs = 1;
+    }
+    else if (strcmp(cmd, "stop") == 0) {
+      data->run_jobs = 0;
+    }
+    else if (strcmp(cmd, "quit") == 0) {
+      quit = 1;
+    }
+    else if (strncmp(cmd, "feed ", 5) == 0) {
+      override_set(data->ovr, atof(cmd + 5) / 100.0);
+      eprintf("Feed override %.0f%%\n", override_user(data->ovr) * 100);
+    }
+    else if (strcmp(cmd, "hold") == 0) {
+      override_hold(data->ovr, 1);
+      eprintf("Feed hold\n");
+    }
+    else if (strcmp(cmd, "resume") == 0) {
+      override_hold(data->ovr, 0);
+      eprintf("Feed resume\n");
+    }
+    else {
+      eprintf("Unknown command: %s\n", cmd);
+    }
+  }
+  return quit;
+}
+
+// Stop request during motion: the first one holds the feed, and the machine
+// stops once at rest; a second one (or streaming segments, where the plant
+// runs the profile) stops at once
+static int motion_exit(ccnc_state_data_t *data) {
+  int n = exit_requested(data);
+  if (n == 0) return 0;
+  if (n > 1 || machine_segments(data->machine) || override_held(data->ovr)) {
+    return 1;
+  }
+  override_hold(data->ovr, 1);
+  return 0;
+}
+
+// Headless idle: process the pending commands, then start the next job if
+// one is ready. Simulated batches are not paced: they wait for the next job
+// to be parsed, rather than spinning here, and quit once the queue is drained
+// (others keep ticking, for they may share a thread, see scheduler.h)
+static ccnc_state_t idle_headless(ccnc_state_data_t *data) {
+  program_t *p;
+  if (poll_commands(data)) {
+    return CCNC_STATE_STOP;
+  }
+  if (data->batch && data->run_jobs && machine_simulate(data->machine)) {
+    if (!(p = jobs_wait(data->jobs))) {
+      return CCNC_STATE_STOP;
+    }
+  }
+  else if (data->batch && jobs_pending(data->jobs) == 0) {
+    return CCNC_STATE_STOP;
+  }
+  else if (!data->run_jobs || !(p = jobs_next(data->jobs))) {
+    return CCNC_NO_CHANGE;
+  }
+  // swap in the next program, already parsed and planned
+  if (data->prog) {
+    program_free(data->prog);
+  }
+  data->prog = p;
+  eprintf("Running job %s\n", program_filename(p));
+  return CCNC_STATE_LOAD_BLOCK;
+}
+
 
 //  ____  _        _        
 // / ___|| |_ __ _| |_ ___  
@@ -18,8 +18,11 @@ Functions and types have been generated with prefix "ccnc_"
 #include "machine.h"
 // #include "program.h"
 #include "program_la.h"
+#include "jobs.h"
+#include "override.h"
 #include "defines.h"
 #include <stdlib.h>
+#include <signal.h>
 
 // State data object
 // By default set to void; override this typedef or load the proper
@@ -29,10 +32,31 @@ typedef struct {
   char const *prog_file;    // G-code program file
   machine_t *machine; // machine object
   program_t *prog;    // program object
-  data_t t_tot;       // total program timer
+  coord_t t_tot;      // total program timer
   data_t t_blk;       // block timer
+  data_t t_carry;     // time past the end of the last block (<= 0 if early)
+  data_t step;        // block time advanced by the last motion tick
+  data_t lambda;      // curvilinear abscissa of the last setpoint
+  data_t feed;        // feedrate of the last setpoint
+  uint64_t setpoints; // setpoints sent, i.e. motion ticks
+  override_t *ovr;    // feed override
+  jobs_t *jobs;       // job queue (headless mode only)
+  int run_jobs;       // headless: run queued jobs back to back
+  int batch;          // headless: quit when the job queue is drained
+  int headless;       // force headless mode regardless of the INI file
+  int exit_request;   // this instance has been asked to stop
+  sig_atomic_t sigint_seen; // SIGINT count already latched
+  FILE *out;          // trajectory output (NULL for stdout)
+  int credit;         // flow control credit left after the last setpoint
+  int credit_tick;    // a setpoint was sent in this tick, see ccnc_credit()
 } ccnc_state_data_t;
 
+// Flow control credit after the tick just run (see machine_credit()), as
+// queried by the motion states, so that the transport is polled once per
+// tick; 0 if the tick sent no setpoint, for only setpoints can run ahead of
+// real time: the other ticks are always paced
+int ccnc_credit(ccnc_state_data_t *data);
+
 // NOTHING SHALL BE CHANGED AFTER THIS LINE!
 
 // List of states
@@ -70,7 +94,7 @@ ccnc_state_t ccnc_do_idle(ccnc_state_data_t *data);
 ccnc_state_t ccnc_do_stop(ccnc_state_data_t *data);
 
 // Function to be executed in state load_block
-// valid return states: CCNC_STATE_IDLE, CCNC_STATE_NO_MOTION, CCNC_STATE_RAPID_MOTION, CCNC_STATE_INTERP_MOTION
+// valid return states: CCNC_STATE_IDLE, CCNC_STATE_LOAD_BLOCK, CCNC_STATE_NO_MOTION, CCNC_STATE_RAPID_MOTION, CCNC_STATE_INTERP_MOTION
 ccnc_state_t ccnc_do_load_block(ccnc_state_data_t *data);
 
 // Function to be executed in state no_motion
@@ -92,8 +116,6 @@ extern state_func_t *const ccnc_state_table[CCNC_NUM_STATES];
 
 // Transition functions
 void ccnc_reset(ccnc_state_data_t *data);
-void ccnc_begin_rapid(ccnc_state_data_t *data);
-void ccnc_begin_interp(ccnc_state_data_t *data);
 void ccnc_end_rapid(ccnc_state_data_t *data);
 
 // Table of transition functions
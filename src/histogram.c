@@ -0,0 +1,162 @@
+//   _   _ _     _
+//  | | | (_)___| |_ ___   __ _ _ __ __ _ _ __ ___
+//  | |_| | / __| __/ _ \ / _` | '__/ _` | '_ ` _ \
+//  |  _  | \__ \ || (_) | (_| | | | (_| | | | | | |
+//  |_| |_|_|___/\__\___/ \__, |_|  \__,_|_| |_| |_|
+//                        |___/
+
+#include "histogram.h"
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+// values below HISTOGRAM_SUB have a bucket each, then every power of two up
+// to 2^63 gets HISTOGRAM_SUB buckets
+#define N_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB)
+
+typedef struct histogram {
+  uint64_t count[N_BUCKETS];
+  uint64_t n, min, max, sum;
+} histogram_t;
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static size_t bucket(uint64_t v);
+static uint64_t bucket_value(size_t i);
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+histogram_t *histogram_new(void) {
+  histogram_t *h = (histogram_t *)malloc(sizeof(histogram_t));
+  if (!h) {
+    perror("Error creating histogram object");
+    exit(EXIT_FAILURE);
+  }
+  histogram_reset(h);
+  return h;
+}
+
+void histogram_free(histogram_t *h) {
+  assert(h);
+  free(h);
+}
+
+void histogram_reset(histogram_t *h) {
+  assert(h);
+  memset(h, 0, sizeof(histogram_t));
+  h->min = UINT64_MAX;
+}
+
+// ALGORITHMS ==================================================================
+
+void histogram_add(histogram_t *h, uint64_t value) {
+  assert(h);
+  h->count[bucket(value)]++;
+  h->n++;
+  h->sum += value;
+  if (value < h->min) h->min = value;
+  if (value > h->max) h->max = value;
+}
+
+void histogram_merge(histogram_t *dst, const histogram_t *src) {
+  assert(dst && src);
+  size_t i;
+  for (i = 0; i < N_BUCKETS; i++) {
+    dst->count[i] += src->count[i];
+  }
+  dst->n += src->n;
+  dst->sum += src->sum;
+  dst->min = MIN(dst->min, src->min);
+  dst->max = MAX(dst->max, src->max);
+}
+
+uint64_t histogram_quantile(const histogram_t *h, data_t q) {
+  assert(h);
+  uint64_t rank, seen = 0;
+  size_t i;
+
+  if (h->n == 0) return 0;
+  rank = (uint64_t)ceil(MIN(MAX(q, 0), 1) * h->n);
+  if (rank == 0) return h->min;
+  for (i = 0; i < N_BUCKETS; i++) {
+    seen += h->count[i];
+    if (seen >= rank) break;
+  }
+  // the extremes are known exactly
+  return MIN(MAX(bucket_value(i), h->min), h->max);
+}
+
+void histogram_print(const histogram_t *h, FILE *out, const char *label, data_t scale) {
+  assert(h && out);
+  fprintf(out, "%s: n=%llu min=%.3f mean=%.3f p50=%.3f p99=%.3f p99.9=%.3f max=%.3f\n",
+    label, (unsigned long long)h->n, histogram_min(h) / scale,
+    histogram_mean(h) / scale, histogram_quantile(h, 0.5) / scale,
+    histogram_quantile(h, 0.99) / scale, histogram_quantile(h, 0.999) / scale,
+    histogram_max(h) / scale);
+}
+
+// ACCESSORS ===================================================================
+
+uint64_t histogram_count(const histogram_t *h) { assert(h); return h->n; }
+uint64_t histogram_min(const histogram_t *h) { assert(h); return h->n ? h->min : 0; }
+uint64_t histogram_max(const histogram_t *h) { assert(h); return h->max; }
+data_t histogram_mean(const histogram_t *h) { assert(h); return h->n ? (double)h->sum / h->n : 0; }
+
+
+//   ____  _        _   _         __
+//  / ___|| |_ __ _| |_(_) ___   / _|_   _ _ __   ___
+//  \___ \| __/ _` | __| |/ __| | |_| | | | '_ \ / __|
+//   ___) | || (_| | |_| | (__  |  _| |_| | | | | (__
+//  |____/ \__\__,_|\__|_|\___| |_|  \__,_|_| |_|\___|
+
+// Bucket of v: the top HISTOGRAM_SUB_BITS + 1 significant bits
+static size_t bucket(uint64_t v) {
+  int e;
+  if (v < HISTOGRAM_SUB) return (size_t)v;
+  e = 63 - __builtin_clzll(v); // position of the most significant bit
+  return (size_t)(e - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB +
+    ((v >> (e - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB - 1));
+}
+
+// Representative value of bucket i: its midpoint
+static uint64_t bucket_value(size_t i) {
+  size_t e, sub;
+  if (i < HISTOGRAM_SUB) return (uint64_t)i;
+  e = i / HISTOGRAM_SUB + HISTOGRAM_SUB_BITS - 1;
+  sub = i % HISTOGRAM_SUB;
+  return ((uint64_t)(HISTOGRAM_SUB + sub) << (e - HISTOGRAM_SUB_BITS)) +
+    ((uint64_t)1 << (e - HISTOGRAM_SUB_BITS)) / 2;
+}
+
+
+//   _____ _____ ____ _____   __  __       _
+//  |_   _| ____/ ___|_   _| |  \/  | __ _(_)_ __
+//    | | |  _| \___ \ | |   | |\/| |/ _` | | '_ \
+//    | | | |___ ___) || |   | |  | | (_| | | | | |
+//    |_| |_____|____/ |_|   |_|  |_|\__,_|_|_| |_|
+// Only needed for testing purpose. To enable, compile as:
+// clang src/histogram.c -o histogram -lm -DHISTOGRAM_MAIN
+#ifdef HISTOGRAM_MAIN
+int main() {
+  histogram_t *h = histogram_new();
+  uint64_t i;
+  // 1 to 100000: the p-th quantile is close to p * 100000
+  for (i = 1; i <= 100000; i++) {
+    histogram_add(h, i);
+  }
+  histogram_print(h, stdout, "uniform", 1);
+  printf("p10 %llu, p90 %llu (expected 10000, 90000)\n",
+    (unsigned long long)histogram_quantile(h, 0.1),
+    (unsigned long long)histogram_quantile(h, 0.9));
+  histogram_free(h);
+  return 0;
+}
+#endif
@@ -0,0 +1,66 @@
+//   _   _ _     _
+//  | | | (_)___| |_ ___   __ _ _ __ __ _ _ __ ___
+//  | |_| | / __| __/ _ \ / _` | '__/ _` | '_ ` _ \
+//  |  _  | \__ \ || (_) | (_| | | | (_| | | | | | |
+//  |_| |_|_|___/\__\___/ \__, |_|  \__,_|_| |_| |_|
+//                        |___/
+//  Log-linear histogram of unsigned values (typically latencies in ns):
+//  each power of two is split into HISTOGRAM_SUB linear buckets, so that
+//  any value is recorded with a relative error below 1/(2*HISTOGRAM_SUB).
+//  Recording is constant time and never allocates.
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "defines.h"
+
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB (1 << HISTOGRAM_SUB_BITS)
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque struct
+typedef struct histogram histogram_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+histogram_t *histogram_new(void);
+void histogram_free(histogram_t *h);
+
+// Forget all the recorded values
+void histogram_reset(histogram_t *h);
+
+// ALGORITHMS ==================================================================
+
+void histogram_add(histogram_t *h, uint64_t value);
+
+// Add all the values recorded in src to dst
+void histogram_merge(histogram_t *dst, const histogram_t *src);
+
+// Value below which the fraction q (0 to 1) of the recorded values lies;
+// 0 if the histogram is empty
+uint64_t histogram_quantile(const histogram_t *h, data_t q);
+
+// Print count, min, mean, p50, p99, p99.9 and max on a single line, with
+// values divided by scale (e.g. 1E3 to print ns as us)
+void histogram_print(const histogram_t *h, FILE *out, const char *label, data_t scale);
+
+// ACCESSORS ===================================================================
+
+uint64_t histogram_count(const histogram_t *h);
+uint64_t histogram_min(const histogram_t *h);
+uint64_t histogram_max(const histogram_t *h);
+data_t histogram_mean(const histogram_t *h);
+
+#endif // HISTOGRAM_H
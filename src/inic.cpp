@@ -21,6 +21,14 @@ declare_ini_get(t) {                                              \
   return r ? 0 : 1;                                               \
 }
 
+#define ini_get_opt(t)                                            \
+declare_ini_get_opt(t) {                                          \
+  t v = 0;                                                        \
+  inipp::Ini<char> *ini = static_cast<inipp::Ini<char> *>(ini_p); \
+  if (!inipp::extract(ini->sections[section][field], v)) return 1;\
+  *val = v;                                                       \
+  return 0;                                                       \
+}
 
 void *ini_init(const char *path) {
   inipp::Ini<char> *ini = new inipp::Ini<char>();
@@ -44,6 +52,10 @@ ini_get(int);
 ini_get(uint64_t);
 ini_get(uint32_t);
 ini_get(long);
+ini_get(data_t);
+ini_get_opt(int);
+ini_get_opt(double);
+ini_get_opt(data_t);
 
 int ini_get_char(void *ini_p, const char *section, const char *field, char *val, size_t len) {
   string str;
@@ -52,3 +64,12 @@ int ini_get_char(void *ini_p, const char *section, const char *field, char *val,
   strncpy(val, str.c_str(), len);
   return r ? 0 : 1;
 }
+
+int ini_get_opt_char(void *ini_p, const char *section, const char *field, char *val, size_t len) {
+  string str;
+  inipp::Ini<char> *ini = static_cast<inipp::Ini<char> *>(ini_p);
+  if (!inipp::extract(ini->sections[section][field], str) || str.empty()) return 1;
+  strncpy(val, str.c_str(), len - 1);
+  val[len - 1] = '\0';
+  return 0;
+}
@@ -27,9 +27,13 @@
  * - `char *field`: field name as a astring
  * - `<type> *val`: pointer to output value
  * 
- * Each function returns 1 if the value has been found in the INI file, 0 
+ * Each function returns 0 if the value has been found in the INI file, 1 
  * otherwise.
  * 
+ * The `ini_get_opt_<type>` functions, for optional fields, do the same but
+ * leave `*val` untouched when the field is missing, so that it keeps its
+ * default value (`ini_get_<type>` clears it).
+ * 
  * @see https://github.com/mcmtroffaes/inipp
  * @ingroup client
  * @ingroup server
@@ -42,6 +46,9 @@
 #define declare_ini_get(t) \
 int ini_get_##t(void *ini_p, const char *section, const char *field, t *val)
 
+#define declare_ini_get_opt(t) \
+int ini_get_opt_##t(void *ini_p, const char *section, const char *field, t *val)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -96,6 +103,37 @@ declare_ini_get(uint32_t);
  */
 declare_ini_get(long);
 
+/**
+ * @brief Construct `ini_get_data_t(void *ini_p, char *section, char *field, data_t *val)`
+ */
+declare_ini_get(data_t);
+
+/**
+ * @brief Construct `ini_get_opt_int(void *ini_p, char *section, char *field, int *val)`
+ */
+declare_ini_get_opt(int);
+
+/**
+ * @brief Construct `ini_get_opt_double(void *ini_p, char *section, char *field, double *val)`
+ */
+declare_ini_get_opt(double);
+
+/**
+ * @brief Construct `ini_get_opt_data_t(void *ini_p, char *section, char *field, data_t *val)`
+ */
+declare_ini_get_opt(data_t);
+
+/**
+ * @brief **Gets an optional char array**: as `ini_get_char()`, but `val` is
+ * left untouched if the field is missing or empty.
+ * @param ini_p the ini object
+ * @param section the name of the ini section
+ * @param field the name of the desired field
+ * @param val the pointer to the destination char array, holding the default
+ * @param len the size of the destination array (pre-allocated)
+ */
+int ini_get_opt_char(void *ini_p, const char *section, const char *field, char *val, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
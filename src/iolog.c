@@ -0,0 +1,201 @@
+//   ___ ___    _
+//  |_ _/ _ \  | |    ___   __ _
+//   | | | | | | |   / _ \ / _` |
+//   | | |_| | | |__| (_) | (_| |
+//  |___\___/  |_____\___/ \__, |
+//                         |___/
+
+#include "iolog.h"
+#include <errno.h>
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+#define MAGIC "CCNC-LOG"
+#define FILE_HEADER_LEN 16
+#define RECORD_HEADER_LEN 14
+#define WRITE_BUFFER (1 << 16) // stdio buffer: records are rarely flushed
+
+typedef struct iolog {
+  FILE *f;
+  int write;
+  size_t count;
+  char topic[IOLOG_TOPIC_LEN + 1]; // last record read
+  uint8_t *payload;                // last record read, plus a terminator
+} iolog_t;
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static void put_le(uint8_t *p, uint64_t v, size_t n);
+static uint64_t get_le(const uint8_t *p, size_t n);
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+iolog_t *iolog_new(const char *path, int write) {
+  assert(path);
+  uint8_t header[FILE_HEADER_LEN] = {0};
+  iolog_t *log = (iolog_t *)calloc(1, sizeof(iolog_t));
+  if (!log) {
+    perror("Error creating I/O log object");
+    return NULL;
+  }
+  log->write = write;
+  if (!(log->f = fopen(path, write ? "wb" : "rb"))) {
+    eprintf("Could not open the I/O log %s: %s\n", path, strerror(errno));
+    free(log);
+    return NULL;
+  }
+  if (write) {
+    setvbuf(log->f, NULL, _IOFBF, WRITE_BUFFER);
+    memcpy(header, MAGIC, 8);
+    header[8] = IOLOG_VERSION;
+    if (fwrite(header, FILE_HEADER_LEN, 1, log->f) != 1) {
+      perror("Could not write the I/O log header");
+      iolog_free(log);
+      return NULL;
+    }
+  }
+  else {
+    if (fread(header, FILE_HEADER_LEN, 1, log->f) != 1 ||
+        memcmp(header, MAGIC, 8) != 0 || header[8] != IOLOG_VERSION) {
+      eprintf("%s is not a version %d I/O log\n", path, IOLOG_VERSION);
+      iolog_free(log);
+      return NULL;
+    }
+    if (!(log->payload = (uint8_t *)malloc(IOLOG_MAX_PAYLOAD + 1))) {
+      perror("Could not allocate the I/O log buffer");
+      iolog_free(log);
+      return NULL;
+    }
+  }
+  return log;
+}
+
+void iolog_free(iolog_t *log) {
+  assert(log);
+  if (log->f) fclose(log->f);
+  free(log->payload);
+  free(log);
+}
+
+// OPERATIONS ==================================================================
+
+int iolog_write(iolog_t *log, iolog_dir_t dir, const char *topic, const void *payload, size_t len) {
+  assert(log && log->write && topic && (payload || len == 0));
+  uint8_t header[RECORD_HEADER_LEN];
+  size_t tlen = strlen(topic);
+
+  if (tlen > IOLOG_TOPIC_LEN || len > IOLOG_MAX_PAYLOAD) return 1;
+  put_le(header, now_ns(), 8);
+  header[8] = (uint8_t)dir;
+  header[9] = (uint8_t)tlen;
+  put_le(header + 10, len, 4);
+  if (fwrite(header, RECORD_HEADER_LEN, 1, log->f) != 1 ||
+      fwrite(topic, 1, tlen, log->f) != tlen ||
+      (len && fwrite(payload, len, 1, log->f) != 1)) {
+    return -1;
+  }
+  log->count++;
+  return 0;
+}
+
+int iolog_read(iolog_t *log, iolog_record_t *rec) {
+  assert(log && !log->write && rec);
+  uint8_t header[RECORD_HEADER_LEN];
+  size_t n, tlen, len;
+
+  if ((n = fread(header, 1, RECORD_HEADER_LEN, log->f)) == 0) return 1;
+  if (n != RECORD_HEADER_LEN) return -1;
+  tlen = header[9];
+  len = (size_t)get_le(header + 10, 4);
+  if (header[8] > IOLOG_IN || len > IOLOG_MAX_PAYLOAD ||
+      fread(log->topic, 1, tlen, log->f) != tlen ||
+      (len && fread(log->payload, len, 1, log->f) != 1)) {
+    return -1;
+  }
+  log->topic[tlen] = '\0';
+  log->payload[len] = '\0';
+  rec->t = get_le(header, 8);
+  rec->dir = (iolog_dir_t)header[8];
+  rec->topic = log->topic;
+  rec->payload = log->payload;
+  rec->len = len;
+  log->count++;
+  return 0;
+}
+
+// ACCESSORS ===================================================================
+
+size_t iolog_count(const iolog_t *log) {
+  assert(log);
+  return log->count;
+}
+
+
+//   ____  _        _   _         __
+//  / ___|| |_ __ _| |_(_) ___   / _|_   _ _ __   ___
+//  \___ \| __/ _` | __| |/ __| | |_| | | | '_ \ / __|
+//   ___) | || (_| | |_| | (__  |  _| |_| | | | | (__
+//  |____/ \__\__,_|\__|_|\___| |_|  \__,_|_| |_|\___|
+
+static void put_le(uint8_t *p, uint64_t v, size_t n) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static uint64_t get_le(const uint8_t *p, size_t n) {
+  uint64_t v = 0;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    v |= (uint64_t)p[i] << (8 * i);
+  }
+  return v;
+}
+
+
+//   _____ _____ ____ _____   __  __       _
+//  |_   _| ____/ ___|_   _| |  \/  | __ _(_)_ __
+//    | | |  _| \___ \ | |   | |\/| |/ _` | | '_ \
+//    | | | |___ ___) || |   | |  | | (_| | | | | |
+//    |_| |_____|____/ |_|   |_|  |_|\__,_|_|_| |_|
+// Only needed for testing purpose. To enable, compile as:
+// clang src/iolog.c src/utils.c -o iolog -DIOLOG_MAIN
+// Then ./iolog FILE dumps a log as CSV (binary payloads as their length)
+#ifdef IOLOG_MAIN
+int main(int argc, char const *argv[]) {
+  iolog_t *log;
+  iolog_record_t rec;
+  uint64_t t0 = 0;
+  size_t i;
+  int rc, text;
+
+  if (argc < 2) {
+    eprintf("Usage: %s IOLOG_FILE\n", argv[0]);
+    return 1;
+  }
+  if (!(log = iolog_new(argv[1], 0))) return 2;
+  printf("t,dir,topic,len,payload\n");
+  while ((rc = iolog_read(log, &rec)) == 0) {
+    if (!t0) t0 = rec.t;
+    for (text = 1, i = 0; i < rec.len && text; i++) {
+      text = ((const uint8_t *)rec.payload)[i] >= 0x20 && ((const uint8_t *)rec.payload)[i] < 0x7f;
+    }
+    printf("%.6f,%s,%s,%zu,%s\n", (rec.t - t0) / 1E9,
+      rec.dir == IOLOG_OUT ? "out" : "in", rec.topic, rec.len,
+      text ? (const char *)rec.payload : "<binary>");
+  }
+  if (rc < 0) eprintf("Truncated record after %zu records\n", iolog_count(log));
+  iolog_free(log);
+  return 0;
+}
+#endif
@@ -0,0 +1,82 @@
+//   ___ ___    _
+//  |_ _/ _ \  | |    ___   __ _
+//   | | | | | | |   / _ \ / _` |
+//   | | |_| | | |__| (_) | (_| |
+//  |___\___/  |_____\___/ \__, |
+//                         |___/
+//  Binary log of the messages exchanged over a transport, for record and
+//  replay. All integers are little endian:
+//    file header (16 bytes): "CCNC-LOG", version (u8), 7 reserved bytes
+//    each record:   offset  size
+//                        0     8  monotonic timestamp (ns, as now_ns())
+//                        8     1  direction, IOLOG_OUT or IOLOG_IN
+//                        9     1  topic length T
+//                       10     4  payload length P
+//                       14     T  topic, not terminated
+//                     14+T     P  payload
+//  A log is written or read by one thread at a time.
+
+#ifndef IOLOG_H
+#define IOLOG_H
+
+#include "defines.h"
+
+#define IOLOG_VERSION 1
+#define IOLOG_TOPIC_LEN 255
+#define IOLOG_MAX_PAYLOAD (1 << 20)
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque struct
+typedef struct iolog iolog_t;
+
+typedef enum {
+  IOLOG_OUT = 0,                // published by this side
+  IOLOG_IN                      // delivered to this side
+} iolog_dir_t;
+
+// A record read back; topic and payload are null-terminated, and valid
+// until the next iolog_read()
+typedef struct {
+  uint64_t t;
+  iolog_dir_t dir;
+  const char *topic;
+  const void *payload;
+  size_t len;
+} iolog_record_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+// Create (write = 1) or open for reading (write = 0) the log at path;
+// NULL on error
+iolog_t *iolog_new(const char *path, int write);
+void iolog_free(iolog_t *log);
+
+// OPERATIONS ==================================================================
+
+// Append a record, timestamped now; return value is 0 on success, 1 if the
+// topic or the payload is too large to be recorded (nothing is written), -1
+// on a write error (the log may end with a partial record)
+int iolog_write(iolog_t *log, iolog_dir_t dir, const char *topic, const void *payload, size_t len);
+
+// Read the next record; return value is 0 on success, 1 at the end of the
+// log, -1 on a truncated or corrupted record
+int iolog_read(iolog_t *log, iolog_record_t *rec);
+
+// ACCESSORS ===================================================================
+
+// Records written or read so far
+size_t iolog_count(const iolog_t *log);
+
+#endif // IOLOG_H
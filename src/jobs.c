@@ -0,0 +1,200 @@
+//       _       _
+//      | | ___ | |__  ___
+//   _  | |/ _ \| '_ \/ __|
+//  | |_| | (_) | |_) \__ \
+//   \___/ \___/|_.__/|___/
+
+#include "jobs.h"
+#include <pthread.h>
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+// Queued file name (linked list)
+typedef struct job {
+  char *filename;
+  struct job *next;
+} job_t;
+
+// Queue object structure
+typedef struct jobs {
+  machine_t *machine;      // machine configuration, for parsing
+  job_t *first, *last;     // files waiting to be parsed
+  size_t queued;           // number of files in the list
+  int parsing;             // the worker is busy on a file
+  program_t *ready;        // parsed program, waiting to be run
+  int quit;                // worker exit request
+  pthread_t worker;        // parsing thread
+  pthread_mutex_t lock;    // protects all of the above
+  pthread_cond_t cond;     // signals new files or a consumed program
+  pthread_cond_t done;     // signals a parsed (or skipped) file
+} jobs_t;
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static void *jobs_worker(void *arg);
+static program_t *jobs_load(const char *filename, machine_t *machine);
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+jobs_t *jobs_new(machine_t *machine) {
+  assert(machine);
+  jobs_t *j = (jobs_t *)calloc(1, sizeof(jobs_t));
+  if (!j) {
+    perror("Could not create job queue");
+    return NULL;
+  }
+  j->machine = machine;
+  pthread_mutex_init(&j->lock, NULL);
+  pthread_cond_init(&j->cond, NULL);
+  pthread_cond_init(&j->done, NULL);
+  if (pthread_create(&j->worker, NULL, jobs_worker, j)) {
+    perror("Could not start the job parsing thread");
+    free(j);
+    return NULL;
+  }
+  return j;
+}
+
+void jobs_free(jobs_t *j) {
+  assert(j);
+  job_t *job, *tmp;
+  pthread_mutex_lock(&j->lock);
+  j->quit = 1;
+  pthread_cond_signal(&j->cond);
+  pthread_mutex_unlock(&j->lock);
+  pthread_join(j->worker, NULL);
+  for (job = j->first; job; job = tmp) {
+    tmp = job->next;
+    free(job->filename);
+    free(job);
+  }
+  if (j->ready) {
+    program_free(j->ready);
+  }
+  pthread_cond_destroy(&j->cond);
+  pthread_cond_destroy(&j->done);
+  pthread_mutex_destroy(&j->lock);
+  free(j);
+  j = NULL;
+}
+
+// QUEUE =======================================================================
+
+int jobs_push(jobs_t *j, const char *filename) {
+  assert(j && filename);
+  job_t *job = (job_t *)calloc(1, sizeof(job_t));
+  if (!job || !(job->filename = strdup(filename))) {
+    perror("Could not queue job");
+    free(job);
+    return 1;
+  }
+  pthread_mutex_lock(&j->lock);
+  if (j->last) j->last->next = job;
+  else j->first = job;
+  j->last = job;
+  j->queued++;
+  pthread_cond_signal(&j->cond);
+  pthread_mutex_unlock(&j->lock);
+  return 0;
+}
+
+program_t *jobs_next(jobs_t *j) {
+  assert(j);
+  program_t *p;
+  pthread_mutex_lock(&j->lock);
+  p = j->ready;
+  j->ready = NULL;
+  // wake up the worker, so that it starts planning the following job
+  if (p) pthread_cond_signal(&j->cond);
+  pthread_mutex_unlock(&j->lock);
+  return p;
+}
+
+program_t *jobs_wait(jobs_t *j) {
+  assert(j);
+  program_t *p;
+  pthread_mutex_lock(&j->lock);
+  while (!j->ready && (j->queued || j->parsing)) {
+    pthread_cond_wait(&j->done, &j->lock);
+  }
+  p = j->ready;
+  j->ready = NULL;
+  if (p) pthread_cond_signal(&j->cond);
+  pthread_mutex_unlock(&j->lock);
+  return p;
+}
+
+size_t jobs_pending(jobs_t *j) {
+  assert(j);
+  size_t n;
+  pthread_mutex_lock(&j->lock);
+  n = j->queued + j->parsing + (j->ready ? 1 : 0);
+  pthread_mutex_unlock(&j->lock);
+  return n;
+}
+
+
+//   ____  _        _   _         __
+//  / ___|| |_ __ _| |_(_) ___   / _|_   _ _ __   ___
+//  \___ \| __/ _` | __| |/ __| | |_| | | | '_ \ / __|
+//   ___) | || (_| | |_| | (__  |  _| |_| | | | | (__
+//  |____/ \__\__,_|\__|_|\___| |_|  \__,_|_| |_|\___|
+
+// Parsing thread: keeps one planned program ready at any time
+static void *jobs_worker(void *arg) {
+  jobs_t *j = (jobs_t *)arg;
+  job_t *job;
+  program_t *p;
+  pthread_mutex_lock(&j->lock);
+  while (1) {
+    while (!j->quit && (j->ready || !j->first)) {
+      pthread_cond_wait(&j->cond, &j->lock);
+    }
+    if (j->quit) break;
+    // dequeue the next file
+    job = j->first;
+    j->first = job->next;
+    if (!j->first) j->last = NULL;
+    j->queued--;
+    j->parsing = 1;
+    pthread_mutex_unlock(&j->lock);
+    // parse and plan without holding the lock
+    p = jobs_load(job->filename, j->machine);
+    free(job->filename);
+    free(job);
+    pthread_mutex_lock(&j->lock);
+    j->parsing = 0;
+    j->ready = p;
+    pthread_cond_signal(&j->done);
+  }
+  pthread_mutex_unlock(&j->lock);
+  return NULL;
+}
+
+// Load, parse and plan a program; NULL on failure (and the job is skipped)
+static program_t *jobs_load(const char *filename, machine_t *machine) {
+  program_t *p = program_new(filename);
+  coord_t min[3], max[3];
+  if (!p) {
+    return NULL;
+  }
+  if (program_parse_partial(p, machine) == EXIT_FAILURE ||
+      program_parse(p) == EXIT_FAILURE) {
+    eprintf("Skipping job %s: parsing failed\n", filename);
+    program_free(p);
+    return NULL;
+  }
+  program_extent(p, min, max);
+  eprintf("Job %s ready (%zu blocks, X %g to %g, Y %g to %g, Z %g to %g)\n",
+    filename, program_length(p), min[0], max[0], min[1], max[1], min[2], max[2]);
+  return p;
+}
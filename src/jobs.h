@@ -0,0 +1,57 @@
+//       _       _
+//      | | ___ | |__  ___
+//   _  | |/ _ \| '_ \/ __|
+//  | |_| | (_) | |_) \__ \
+//   \___/ \___/|_.__/|___/
+//  Job queue for headless mode: G-code files are parsed and planned in a
+//  background thread, so that the next program is ready when the current
+//  one ends
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "defines.h"
+#include "machine.h"
+#include "program_la.h"
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque structure
+typedef struct jobs jobs_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+// Create an empty queue and start its parsing thread
+jobs_t *jobs_new(machine_t *machine);
+
+// Stop the parsing thread and free any queued or parsed program
+void jobs_free(jobs_t *j);
+
+// QUEUE =======================================================================
+
+// Append a G-code file to the queue; return value is 0 on success
+int jobs_push(jobs_t *j, const char *filename);
+
+// Get the next parsed and planned program, or NULL if none is ready yet.
+// Never waits for parsing to complete. The caller owns the returned program
+program_t *jobs_next(jobs_t *j);
+
+// Same as jobs_next(), but waits for parsing to complete: NULL only once
+// no job is queued, being parsed, or ready
+program_t *jobs_wait(jobs_t *j);
+
+// Number of jobs that are queued, being parsed, or ready
+size_t jobs_pending(jobs_t *j);
+
+#endif // JOBS_H
@@ -0,0 +1,47 @@
+//   _                _       __
+//  | |    ___   ___| | __  / _|_ __ ___  ___
+//  | |   / _ \ / __| |/ / | |_| '__/ _ \/ _ \
+//  | |__| (_) | (__|   <  |  _| | |  __/  __/
+//  |_____\___/ \___|_|\_\ |_| |_|  \___|\___|
+
+#include "lockfree.h"
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// round up to the next power of 2
+static size_t pow2_ceil(size_t n) {
+  size_t p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
+
+size_t spsc_footprint(size_t capacity, size_t elem_size) {
+  return sizeof(spsc_t) + pow2_ceil(capacity) * elem_size;
+}
+
+void spsc_init(spsc_t *q, size_t capacity, size_t elem_size) {
+  assert(q && elem_size > 0);
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  q->elem_size = elem_size;
+  q->mask = pow2_ceil(capacity) - 1;
+}
+
+spsc_t *spsc_new(size_t capacity, size_t elem_size) {
+  spsc_t *q = NULL;
+  if (posix_memalign((void **)&q, LF_CACHELINE, spsc_footprint(capacity, elem_size))) {
+    perror("Could not allocate SPSC ring");
+    return NULL;
+  }
+  spsc_init(q, capacity, elem_size);
+  return q;
+}
+
+void spsc_free(spsc_t *q) {
+  assert(q);
+  free(q);
+}
@@ -0,0 +1,126 @@
+//   _                _       __
+//  | |    ___   ___| | __  / _|_ __ ___  ___
+//  | |   / _ \ / __| |/ / | |_| '__/ _ \/ _ \
+//  | |__| (_) | (__|   <  |  _| | |  __/  __/
+//  |_____\___/ \___|_|\_\ |_| |_|  \___|\___|
+//  Lock-free primitives for sharing data between the control thread and the
+//  network I/O thread: a single-producer/single-consumer ring and a seqlock
+
+#ifndef LOCKFREE_H
+#define LOCKFREE_H
+
+#include "defines.h"
+#include <stdatomic.h>
+
+#define LF_CACHELINE 64
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// SPSC ring of fixed-size elements. Head and tail live on separate cache
+// lines, so that producer and consumer do not false-share. The element
+// storage follows the header, so that the whole ring is a single contiguous
+// block of memory with no internal pointers.
+typedef struct {
+  _Atomic size_t head;  // next slot to write (owned by the producer)
+  char pad_h[LF_CACHELINE - sizeof(size_t)];
+  _Atomic size_t tail;  // next slot to read (owned by the consumer)
+  char pad_t[LF_CACHELINE - sizeof(size_t)];
+  size_t elem_size;     // size of one element in bytes
+  size_t mask;          // capacity - 1 (capacity is a power of 2)
+  uint8_t data[];       // elements
+} spsc_t;
+
+// Seqlock: one writer, any number of readers that never block the writer.
+// The counter is odd while a write is in progress.
+typedef struct {
+  _Atomic uint32_t seq;
+} seqlock_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// SPSC LIFECYCLE ==============================================================
+
+// Memory needed by a ring of (at least) capacity elements
+size_t spsc_footprint(size_t capacity, size_t elem_size);
+
+// Initialize a ring on already allocated memory of spsc_footprint() bytes
+void spsc_init(spsc_t *q, size_t capacity, size_t elem_size);
+
+// Allocate and initialize a ring; capacity is rounded up to a power of 2
+spsc_t *spsc_new(size_t capacity, size_t elem_size);
+void spsc_free(spsc_t *q);
+
+// SPSC OPERATIONS =============================================================
+// These are on the hot path, hence inlined
+
+// Producer side: returns 0 on success, 1 if the ring is full
+static inline int spsc_push(spsc_t *q, const void *elem) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  if (head - tail > q->mask) return 1;
+  memcpy(q->data + (head & q->mask) * q->elem_size, elem, q->elem_size);
+  atomic_store_explicit(&q->head, head + 1, memory_order_release);
+  return 0;
+}
+
+// Consumer side: returns 0 on success, 1 if the ring is empty
+static inline int spsc_pop(spsc_t *q, void *elem) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+  if (head == tail) return 1;
+  memcpy(elem, q->data + (tail & q->mask) * q->elem_size, q->elem_size);
+  atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+  return 0;
+}
+
+// Number of elements currently queued (approximate from the other side)
+static inline size_t spsc_count(spsc_t *q) {
+  return atomic_load_explicit(&q->head, memory_order_acquire) -
+         atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+// SEQLOCK =====================================================================
+
+static inline void seqlock_init(seqlock_t *l) {
+  atomic_init(&l->seq, 0);
+}
+
+// Writer: copy size bytes from src into the protected storage dst
+static inline void seqlock_write(seqlock_t *l, void *dst, const void *src, size_t size) {
+  uint32_t s = atomic_load_explicit(&l->seq, memory_order_relaxed);
+  atomic_store_explicit(&l->seq, s + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(dst, src, size);
+  atomic_store_explicit(&l->seq, s + 2, memory_order_release);
+}
+
+// Reader: copy the protected storage src into dst, retrying while a write
+// is in progress. Returns the sequence number of the copied snapshot, which
+// grows by 2 on each write
+static inline uint32_t seqlock_read(seqlock_t *l, void *dst, const void *src, size_t size) {
+  uint32_t s0, s1;
+  do {
+    s0 = atomic_load_explicit(&l->seq, memory_order_acquire);
+    if (s0 & 1) continue;
+    memcpy(dst, src, size);
+    atomic_thread_fence(memory_order_acquire);
+    s1 = atomic_load_explicit(&l->seq, memory_order_relaxed);
+  } while ((s0 & 1) || s0 != s1);
+  return s0;
+}
+
+// Current sequence number, without reading the data
+static inline uint32_t seqlock_seq(seqlock_t *l) {
+  return atomic_load_explicit(&l->seq, memory_order_acquire);
+}
+
+#endif // LOCKFREE_H
@@ -4,9 +4,11 @@
 //  | |  | | (_| | (__| | | | | | | |  __/
 //  |_|  |_|\__,_|\___|_| |_|_|_| |_|\___|
 //
-#include "machine.h"
+// this file defines the out-of-line getters
+#define MACHINE_IMPL
+#include "machine_layout.h"
 #include "inic.h"
-#include <mqtt_protocol.h>
+#include "segment.h"
 #include <unistd.h>
 
 
@@ -16,26 +18,28 @@
 //  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
 //  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
                                                           
-#define BUFLEN 1024
-typedef struct machine {
-  data_t A, tq;                 // max acceleration and timestep
-  data_t max_error, error;      // max positioning error and actual error
-  point_t *zero, *offset;       // machine reference zero and workpiece offset
-  point_t *setpoint, *position; // desired and actual position
-  char broker_address[BUFLEN];
-  int broker_port;
-  char pub_topic[BUFLEN];
-  char sub_topic[BUFLEN];
-  char pub_buffer[BUFLEN];
-  struct mosquitto *mqt;
-  struct mosquitto_message *msg;
-  int connecting;
-  data_t rt_pacing;
-} machine_t;
+#define BUFLEN MACHINE_BUFLEN
+#define SP_QUEUE_LEN 1024  // setpoints buffered towards the I/O thread
+#define IO_LOOP_TIMEOUT 1  // ms, max latency of a queued setpoint
+#define CMD_QUEUE_LEN 64   // pending commands for headless mode
+#define SEG_QUEUE_LEN 64   // segments buffered towards the I/O thread
+#define TRACK_LEN 1024     // sent setpoints kept for the tracking error
+#define STATS_WINDOW 1.0   // s, rolling window of latency and error stats
 
 // callbacks
-static void on_connect(struct mosquitto *mqt, void *obj, int rc);
-static void on_message(struct mosquitto *mqt, void *ud, const struct mosquitto_message *msg);
+static void on_message(void *ud, const char *topic, const void *payload, size_t len);
+static void *io_loop(void *arg);
+static void io_stop(machine_t *m);
+static void publish_setpoint(machine_t *m, const setpoint_msg_t *sp);
+static void publish_flush(machine_t *m, int force);
+static void publish_segment(machine_t *m, const segment_t *s);
+static void feedback_read(machine_t *m);
+static void estimate_update(machine_t *m);
+static void topics_resolve(machine_t *m);
+static const char *parse_number(const char *p, const char *end, double *v);
+static const char *parse_uint(const char *p, const char *end, uint64_t *v);
+static void track_update(machine_t *m, uint32_t seq, uint64_t t, const double pos[3]);
+static void stats_close(machine_t *m, uint64_t now);
 
 //   _____                 _   _                 
 //  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___ 
@@ -48,23 +52,34 @@ static void on_message(struct mosquitto *mqt, void *ud, const struct mosquitto_m
 // Create a new instance reading data from an INI file
 // If the INI file is not given (NULL), provide sensible default values
 machine_t *machine_new(const char *ini_path) {
-  machine_t *m = (machine_t *)calloc(1, sizeof(machine_t));
-  if (!m) {
+  machine_t *m = NULL;
+  data_t alpha = 0.5, beta = 0.1;
+  int estimate = 0;
+  // aligned for the field groups (see machine_layout.h)
+  if (posix_memalign((void **)&m, LF_CACHELINE, sizeof(machine_t))) {
     perror("Error creating machine object");
     exit(EXIT_FAILURE);
   }
+  memset(m, 0, sizeof(machine_t));
+  transport_defaults(&m->tcfg);
+  // rapids: defaults, the INI file may override them
+  m->rapid_v = point_new();
+  point_set_xyz(m->rapid_v, 10000, 10000, 5000);
+  m->rapid_settle = 0.05;
+  m->rapid_tol = 0.02;
   if (ini_path) { // load values from INI file
     void *ini = ini_init(ini_path);
-    data_t x, y, z;
-    int rc = 0;
+    double x, y, z;
+    char payload[BUFLEN] = "", stream[BUFLEN] = "";
+    int rc = 0, fmt;
     if (!ini) {
       fprintf(stderr, "Could not open the ini file %s\n", ini_path);
       return NULL;
     }
-    rc += ini_get_double(ini, "C-CNC", "A", &m->A);
-    rc += ini_get_double(ini, "C-CNC", "max_error", &m->max_error);
-    rc += ini_get_double(ini, "C-CNC", "tq", &m->tq);
-    rc += ini_get_double(ini, "C-CNC", "rt_pacing", &m->rt_pacing);
+    rc += ini_get_data_t(ini, "C-CNC", "A", &m->A);
+    rc += ini_get_data_t(ini, "C-CNC", "max_error", &m->max_error);
+    rc += ini_get_data_t(ini, "C-CNC", "tq", &m->tq);
+    rc += ini_get_data_t(ini, "C-CNC", "rt_pacing", &m->rt_pacing);
     rc += ini_get_double(ini, "C-CNC", "origin_x", &x);
     rc += ini_get_double(ini, "C-CNC", "origin_y", &y);
     rc += ini_get_double(ini, "C-CNC", "origin_z", &z);
@@ -75,11 +90,50 @@ machine_t *machine_new(const char *ini_path) {
     rc += ini_get_double(ini, "C-CNC", "offset_z", &z);
     m->offset = point_new();
     point_set_xyz(m->offset, x, y, z);
-    rc += ini_get_char(ini, "MQTT", "broker_addr", m->broker_address, BUFLEN);
-    rc += ini_get_int(ini, "MQTT", "broker_port", &m->broker_port);
+    rc += transport_config(&m->tcfg, ini);
     rc += ini_get_char(ini, "MQTT", "pub_topic", m->pub_topic, BUFLEN);
     rc += ini_get_char(ini, "MQTT", "sub_topic", m->sub_topic, BUFLEN);
+    // optional parameters
+    ini_get_opt_int(ini, "C-CNC", "estimator", &estimate);
+    ini_get_opt_data_t(ini, "C-CNC", "est_alpha", &alpha);
+    ini_get_opt_data_t(ini, "C-CNC", "est_beta", &beta);
+    ini_get_opt_int(ini, "C-CNC", "headless", &m->headless);
+    ini_get_opt_int(ini, "C-CNC", "simulate", &m->simulate);
+    ini_get_opt_char(ini, "C-CNC", "sim_sink", m->sim_sink, BUFLEN);
+    ini_get_opt_char(ini, "C-CNC", "telemetry", m->telemetry, BUFLEN);
+    x = point_x(m->rapid_v);
+    y = point_y(m->rapid_v);
+    z = point_z(m->rapid_v);
+    ini_get_opt_double(ini, "C-CNC", "rapid_vx", &x);
+    ini_get_opt_double(ini, "C-CNC", "rapid_vy", &y);
+    ini_get_opt_double(ini, "C-CNC", "rapid_vz", &z);
+    point_set_xyz(m->rapid_v, x, y, z);
+    ini_get_opt_data_t(ini, "C-CNC", "rapid_settle", &m->rapid_settle);
+    ini_get_opt_data_t(ini, "C-CNC", "rapid_tol", &m->rapid_tol);
+    ini_get_opt_int(ini, "MQTT", "io_thread", &m->threaded);
+    ini_get_opt_char(ini, "MQTT", "cmd_topic", m->cmd_topic, BUFLEN);
+    ini_get_opt_int(ini, "MQTT", "batch", &m->batch);
+    ini_get_opt_int(ini, "MQTT", "debug", &m->debug);
+    ini_get_opt_int(ini, "MQTT", "stats", &m->stats);
+    ini_get_opt_int(ini, "MQTT", "feed_forward", &m->feed_forward);
+    ini_get_opt_char(ini, "MQTT", "payload", payload, BUFLEN);
+    if ((fmt = setpoint_format(payload)) < 0) {
+      eprintf("Unknown setpoint payload format %s\n", payload);
+      rc++;
+    }
+    m->payload = fmt < 0 ? SETPOINT_JSON : fmt;
+    ini_get_opt_char(ini, "MQTT", "stream", stream, BUFLEN);
+    if (strcmp(stream, "segments") == 0) {
+      m->segments = 1;
+    }
+    else if (stream[0] && strcmp(stream, "points") != 0) {
+      eprintf("Unknown stream mode %s\n", stream);
+      rc++;
+    }
     ini_free(ini);
+    if (estimate && !(m->est = estimator_new(alpha, beta))) {
+      rc++;
+    }
     if (rc > 0) {
       fprintf(stderr, "Missing/wrong %d config parameters\n", rc);
       return NULL;
@@ -89,12 +143,11 @@ machine_t *machine_new(const char *ini_path) {
     m->A = 125;
     m->max_error = 0.005;
     m->tq = 0.005;
+    m->rt_pacing = 1;
     m->zero = point_new();
     point_set_xyz(m->zero, 0, 0, 0);
     m->offset = point_new();
     point_set_xyz(m->offset, 0, 0, 0);
-    strcpy(m->broker_address, "localhost");
-    m->broker_port = 1883;
     strcpy(m->pub_topic, "c-cnc/setpoint");
     strcpy(m->sub_topic, "c-cnc/status/#");
   }
@@ -102,12 +155,43 @@ machine_t *machine_new(const char *ini_path) {
   point_modal(m->zero, m->setpoint);
   m->position = point_new();
   m->error = m->max_error;
-  m->mqt = NULL;
-  if (mosquitto_lib_init() != MOSQ_ERR_SUCCESS) {
-    perror("Could not initialize Mosquitto library");
+  m->position_est = point_new();
+  m->error_est = m->error;
+  m->tr = NULL;
+  m->tcfg.subs[0] = m->sub_topic;
+  m->tcfg.subs[1] = m->cmd_topic;
+  topics_resolve(m);
+  // batching: buffers for K setpoints, in either format
+  m->batch = MAX(m->batch, 1);
+  m->pub_len = m->batch * SETPOINT_JSON_LEN + 2;
+  m->pub_buffer = (char *)malloc(m->pub_len);
+  m->batch_buf = (setpoint_msg_t *)calloc(m->batch, sizeof(setpoint_msg_t));
+  if (!m->pub_buffer || !m->batch_buf) {
+    perror("Could not allocate setpoint buffers");
+    exit(EXIT_FAILURE);
+  }
+  seqlock_init(&m->fb_lock);
+  atomic_init(&m->io_running, 0);
+  if (m->threaded) {
+    m->sp_queue = spsc_new(SP_QUEUE_LEN, sizeof(setpoint_msg_t));
+    m->seg_queue = spsc_new(SEG_QUEUE_LEN, sizeof(segment_t));
+    if (!m->sp_queue || !m->seg_queue) {
+      exit(EXIT_FAILURE);
+    }
+  }
+  m->cmd_queue = spsc_new(CMD_QUEUE_LEN, MACHINE_CMD_LEN);
+  if (!m->cmd_queue) {
+    exit(EXIT_FAILURE);
+  }
+  m->sent = (setpoint_msg_t *)calloc(TRACK_LEN, sizeof(setpoint_msg_t));
+  if (!m->sent) {
+    perror("Could not allocate the setpoint history");
     exit(EXIT_FAILURE);
   }
-  m->connecting = 1;
+  m->rtt = histogram_new();
+  m->track = histogram_new();
+  m->rtt_all = histogram_new();
+  m->track_all = histogram_new();
   return m;
 }
 
@@ -117,61 +201,176 @@ void machine_free(machine_t *m) {
   point_free(m->offset);
   point_free(m->setpoint);
   point_free(m->position);
-  if (m->mqt) {
-    mosquitto_destroy(m->mqt);
+  point_free(m->position_est);
+  point_free(m->rapid_v);
+  if (m->est) {
+    estimator_free(m->est);
+  }
+  io_stop(m);
+  if (m->sink) {
+    fclose(m->sink);
+  }
+  if (m->sp_queue) {
+    spsc_free(m->sp_queue);
+  }
+  if (m->seg_queue) {
+    spsc_free(m->seg_queue);
+  }
+  spsc_free(m->cmd_queue);
+  free(m->pub_buffer);
+  free(m->batch_buf);
+  free(m->sent);
+  histogram_free(m->rtt);
+  histogram_free(m->track);
+  histogram_free(m->rtt_all);
+  histogram_free(m->track_all);
+  if (m->tr) {
+    transport_free(m->tr);
   }
-  mosquitto_lib_cleanup();
   free(m);
   m = NULL;
 }
 
-// MQTT COMMUNICATIONS =========================================================
+// COMMUNICATIONS ==============================================================
 
 // return value is 0 on success
 int machine_connect(machine_t *m, machine_on_message callback) {
   assert(m);
-  m->mqt = mosquitto_new(NULL, 1, m);
-  if (!m->mqt) {
-    perror("Could not create MQTT");
+  // simulation: setpoints go to a local sink instead of the broker
+  if (m->simulate) {
+    if (m->sim_sink[0] && !(m->sink = fopen(m->sim_sink, "w"))) {
+      perror("Could not open the simulation sink");
+      return 1;
+    }
+    if (m->sink) fprintf(m->sink, "x,y,z,rapid\n");
+    eprintf("-> Simulation mode, no broker\n");
+    return 0;
+  }
+  m->tr = transport_new(&m->tcfg, callback ? callback : on_message, m);
+  if (!m->tr) {
     return 1;
   }
-  mosquitto_connect_callback_set(m->mqt, on_connect);
-  mosquitto_message_callback_set(m->mqt, callback ? callback : on_message);
-  if (mosquitto_connect(m->mqt, m->broker_address, m->broker_port, 60) != MOSQ_ERR_SUCCESS) {
-    perror("Could not connect to broker");
+  if (transport_connect(m->tr)) {
+    eprintf("Could not connect over %s\n", transport_name(m->tr));
     return 2;
   }
-  // wait for connection to establish
-  while (m->connecting) {
-    mosquitto_loop(m->mqt, -1, 1);
+  // from now on, all network traffic goes through the I/O thread
+  if (m->threaded) {
+    atomic_store(&m->io_running, 1);
+    if (pthread_create(&m->io_thread, NULL, io_loop, m)) {
+      perror("Could not start the I/O thread");
+      atomic_store(&m->io_running, 0);
+      return 3;
+    }
   }
   return 0;
 }
 
 int machine_sync(machine_t *m, int rapid) {
   assert(m);
-  //  remember that mosquitto_loop must be called in order to comms to happen
-  if (mosquitto_loop(m->mqt, 0, 1) != MOSQ_ERR_SUCCESS) {
-    perror("mosquitto_loop error");
+  // compensate for the workpiece offset from the INI file:
+  setpoint_msg_t sp = {
+    .x = point_x(m->setpoint) + point_x(m->offset),
+    .y = point_y(m->setpoint) + point_y(m->offset),
+    .z = point_z(m->setpoint) + point_z(m->offset),
+    .seq = m->sp_seq++,
+    .t = now_ns(),
+    .flags = (rapid ? SETPOINT_RAPID : 0) | (m->feed_forward ? SETPOINT_FF : 0)
+  };
+  if (m->feed_forward) {
+    int i;
+    for (i = 0; i < 3; i++) {
+      sp.v[i] = m->sp_v[i];
+      sp.a[i] = m->sp_a[i];
+    }
+  }
+  if (m->est && !m->simulate && !m->segments) {
+    coord_t p[3] = {sp.x, sp.y, sp.z};
+    estimator_command(m->est, sp.seq, sp.t, p);
+  }
+  // simulation: the ideal machine is always exactly on the setpoint
+  if (m->simulate) {
+    point_set_xyz(m->position, sp.x, sp.y, sp.z);
+    m->error = 0;
+    if (m->sink) fprintf(m->sink, "%f,%f,%f,%d\n", sp.x, sp.y, sp.z, rapid);
+    return 0;
+  }
+  // segment streaming: the plant samples the segments itself, setpoints are
+  // only kept locally
+  if (m->segments) {
+    machine_listen_update(m);
+    return 0;
+  }
+  // threaded: hand the setpoint over to the I/O thread, no syscalls here
+  if (m->threaded) {
+    feedback_read(m);
+    if (spsc_push(m->sp_queue, &sp)) {
+      if (m->sp_dropped++ == 0)
+        eprintf("Setpoint queue full, dropping setpoints\n");
+      return 1;
+    }
+    return 0;
+  }
+  //  remember that the transport must be polled in order to comms to happen
+  if (transport_poll(m->tr, 0)) {
+    perror("transport poll error");
     return 1;
   }
-  // fill up pub_buffer with current set point, comma separated
-  // also, compensate for the workpiece offset from the INI file:
-  snprintf(m->pub_buffer, BUFLEN, "{\"x\":%f,\"y\":%f,\"z\":%f,\"rapid\":%s}", 
-    point_x(m->setpoint) + point_x(m->offset), 
-    point_y(m->setpoint) + point_y(m->offset), 
-    point_z(m->setpoint) + point_z(m->offset),
-    rapid ? "true" : "false"
-  );
-  // send buffer over MQTT
-  mosquitto_publish(m->mqt, NULL, m->pub_topic, strlen(m->pub_buffer), m->pub_buffer, 0, 0);
+  feedback_read(m);
+  publish_setpoint(m, &sp);
+  // the plant has no room for more: send it what it can take now
+  if (m->flow && (int32_t)(m->credit_limit - sp.seq) <= 0) publish_flush(m, 1);
   return 0;
 }
 
+void machine_set_derivatives(machine_t *m, const data_t v[3], const data_t a[3]) {
+  assert(m && v && a);
+  memcpy(m->sp_v, v, sizeof(m->sp_v));
+  memcpy(m->sp_a, a, sizeof(m->sp_a));
+}
+
+int machine_credit(machine_t *m) {
+  assert(m);
+  int credit;
+  if (m->simulate || !m->tr || m->segments) return -1;
+  if (!m->threaded) {
+    if (transport_poll(m->tr, 0)) {
+      perror("transport poll error");
+    }
+    // a batch cannot wait for setpoints that are not going to come
+    publish_flush(m, 0);
+  }
+  feedback_read(m);
+  if (!m->flow) return -1;
+  // signed difference, for sequence numbers wrap around
+  credit = (int32_t)(m->credit_limit - m->sp_seq) + 1;
+  if (credit <= 0 && !m->threaded) publish_flush(m, 1);
+  return MAX(credit, 0);
+}
+
+int machine_stream(machine_t *m, segment_t *s) {
+  assert(m && s);
+  s->seq = m->seg_seq++;
+  if (m->simulate || !m->segments) return 0;
+  if (m->threaded) {
+    if (spsc_push(m->seg_queue, s)) {
+      eprintf("Segment queue full, dropping segment %u\n", s->seq);
+      return 1;
+    }
+    return 0;
+  }
+  publish_segment(m, s);
+  return 0;
+}
 
 int machine_listen_start(machine_t *m) {
+  // the I/O thread keeps the subscription made on connection
+  if (m->threaded || m->simulate) {
+    m->error = m->max_error * 10.0;
+    return 0;
+  }
   // subscribe to the topic where the machine publishes to
-  if (mosquitto_subscribe(m->mqt, NULL, m->sub_topic, 0) != MOSQ_ERR_SUCCESS) {
+  if (transport_subscribe(m->tr, m->sub_topic)) {
     perror("Could not subscribe");
     return 1;
   }
@@ -181,7 +380,10 @@ int machine_listen_start(machine_t *m) {
 }
 
 int machine_listen_stop(machine_t *m) {
-  if (mosquitto_unsubscribe(m->mqt, NULL, m->sub_topic) != MOSQ_ERR_SUCCESS) {
+  if (m->threaded || m->simulate) {
+    return 0;
+  }
+  if (transport_unsubscribe(m->tr, m->sub_topic)) {
     perror("Could not unsubscribe");
     return 1;
   }
@@ -190,19 +392,44 @@ int machine_listen_stop(machine_t *m) {
 }
 
 void machine_listen_update(machine_t *m) {
-  // call mosquitto_loop
-  if (mosquitto_loop(m->mqt, 0, 1) != MOSQ_ERR_SUCCESS) {
-    perror("mosquitto_loop error");
+  if (m->simulate) return;
+  // poll the transport, unless the I/O thread is doing it
+  if (!m->threaded) {
+    if (transport_poll(m->tr, 0)) {
+      perror("transport poll error");
+    }
+    publish_flush(m, 0);
   }
+  feedback_read(m);
+}
+
+// Fetch the oldest pending command into cmd (MACHINE_CMD_LEN bytes)
+// return value is 0 if a command was available
+int machine_command(machine_t *m, char *cmd) {
+  assert(m && cmd);
+  return spsc_pop(m->cmd_queue, cmd);
 }
 
 void machine_disconnect(machine_t *m) {
-  if (m->mqt) {
-    while (mosquitto_want_write(m->mqt)) {
-      mosquitto_loop(m->mqt, 0, 1);
+  io_stop(m);
+  if (m->tr) {
+    publish_flush(m, 1);
+    while (transport_pending(m->tr)) {
+      transport_poll(m->tr, 0);
       usleep(10000);
     }
-    mosquitto_disconnect(m->mqt);
+    transport_disconnect(m->tr);
+  }
+  // whole-run statistics, now that nobody else touches them
+  if (histogram_count(m->rtt) > 0) {
+    histogram_merge(m->rtt_all, m->rtt);
+    histogram_merge(m->track_all, m->track);
+    histogram_reset(m->rtt);
+    histogram_reset(m->track);
+  }
+  if (histogram_count(m->rtt_all) > 0) {
+    histogram_print(m->rtt_all, stderr, "Setpoint round trip (ms)", 1E6);
+    histogram_print(m->track_all, stderr, "Tracking error (um)", 1E3);
   }
 }
 
@@ -223,53 +450,349 @@ machine_getter(point_t *, zero);
 machine_getter(point_t *, offset);
 machine_getter(point_t *, setpoint);
 machine_getter(point_t *, position);
+machine_getter(point_t *, position_est);
+machine_getter(data_t, error_est);
+machine_getter(point_t *, rapid_v);
+machine_getter(data_t, rapid_settle);
+machine_getter(data_t, rapid_tol);
 machine_getter(data_t, rt_pacing);
+machine_getter(int, headless);
+machine_getter(int, simulate);
+machine_getter(int, segments);
+machine_getter(int, feed_forward);
+
+int machine_settled(const machine_t *m) {
+  assert(m);
+  data_t d;
+  if (!m->est || !estimator_valid(m->est)) return 0;
+  d = sqrt(pow(point_x(m->position_est) - point_x(m->setpoint) - point_x(m->offset), 2) +
+    pow(point_y(m->position_est) - point_y(m->setpoint) - point_y(m->offset), 2) +
+    pow(point_z(m->position_est) - point_z(m->setpoint) - point_z(m->offset), 2));
+  return d <= m->max_error;
+}
+
+const char *machine_telemetry(const machine_t *m) {
+  assert(m);
+  return m->telemetry[0] ? m->telemetry : NULL;
+}
+
+const machine_stats_t *machine_stats(const machine_t *m) {
+  assert(m);
+  return &m->last_stats;
+}
 
 
 
 // STATIC FUNCTIONS
 
-static void on_connect(struct mosquitto *mqt, void *obj, int rc) {
-  machine_t *m = (machine_t *)obj;
-  // Successful connection
-  if (rc == CONNACK_ACCEPTED) {
-    eprintf("-> Connected to %s:%d\n", m->broker_address, m->broker_port);
-    // subscribe
-    if (mosquitto_subscribe(mqt, NULL, m->sub_topic, 0) != MOSQ_ERR_SUCCESS) {
-      perror("Could not subscribe");
-      exit(EXIT_FAILURE);
+// Runs for every incoming message, possibly at the plant feedback rate: no
+// allocations, no copies of the message, no logging unless debug is set
+static void on_message(void *ud, const char *topic, const void *payload, size_t payloadlen) {
+  machine_t *m = (machine_t *)ud;
+  const char *p = (const char *)payload;
+  const char *end = p + payloadlen;
+  size_t len = strlen(topic);
+  double v[3];
+  int id;
+
+  if (m->debug) {
+    eprintf("<- message: %s:%.*s\n", topic, (int)payloadlen, p);
+  }
+  for (id = 0; id < TOPIC_COUNT; id++) {
+    if (m->topics[id].len == len && memcmp(m->topics[id].name, topic, len) == 0)
+      break;
+  }
+
+  // values go into the shadow copy first, then into the shared snapshot:
+  // the control loop picks them up in feedback_read()
+  switch (id) {
+  case TOPIC_COMMAND: {
+    // commands are queued as null-terminated strings for the FSM
+    char cmd[MACHINE_CMD_LEN] = {0};
+    memcpy(cmd, p, MIN(payloadlen, MACHINE_CMD_LEN - 1));
+    if (spsc_push(m->cmd_queue, cmd))
+      eprintf("Command queue full, dropping %s\n", cmd);
+    return;
+  }
+  case TOPIC_ERROR:
+    if (!parse_number(p, end, &v[0])) goto malformed;
+    m->fb_shadow.error = v[0];
+    m->fb_shadow.n_err++;
+    break;
+  case TOPIC_BUFFER:
+    // "seq,free": last setpoint received by the plant, free buffer slots
+    if (!(p = parse_number(p, end, &v[0])) || !parse_number(p + 1, end, &v[1]))
+      goto malformed;
+    m->fb_shadow.buf_seq = (uint32_t)v[0];
+    m->fb_shadow.buf_free = (uint32_t)v[1];
+    m->fb_shadow.n_buf++;
+    break;
+  case TOPIC_POSITION: {
+    // "x,y,z", as in "123.4,100.0,-98", optionally followed by ",seq,t":
+    // the last setpoint the plant has applied, and its timestamp verbatim
+    uint64_t seq, t;
+    if (!(p = parse_number(p, end, &v[0])) ||
+        !(p = parse_number(p + 1, end, &v[1])) ||
+        !(p = parse_number(p + 1, end, &v[2])))
+      goto malformed;
+    m->fb_shadow.x = v[0];
+    m->fb_shadow.y = v[1];
+    m->fb_shadow.z = v[2];
+    m->fb_shadow.n_pos++;
+    m->fb_shadow.pos_t = 0;
+    if (p < end && *p == ',') {
+      if (!(p = parse_uint(p + 1, end, &seq)) || p >= end || *p != ',' ||
+          !parse_uint(p + 1, end, &t))
+        goto malformed;
+      track_update(m, (uint32_t)seq, t, v);
+      m->fb_shadow.pos_seq = (uint32_t)seq;
+      m->fb_shadow.pos_t = t;
+    }
+    break;
+  }
+  default:
+    if (m->debug) eprintf("Got unexpected message on %s\n", topic);
+    return;
+  }
+  seqlock_write(&m->fb_lock, &m->fb, &m->fb_shadow, sizeof(feedback_t));
+  return;
+
+malformed:
+  if (m->debug) eprintf("Malformed payload on %s\n", topic);
+}
+
+// Apply the latest feedback snapshot to position and error. Only the fields
+// that changed since the last call are updated, so that a reset error (see
+// machine_listen_start()) is not overwritten by a stale value. The estimate
+// is refreshed on every call, samples or not
+static void feedback_read(machine_t *m) {
+  feedback_t fb;
+  if (seqlock_seq(&m->fb_lock) == 0) { // nothing received yet
+    estimate_update(m);
+    return;
+  }
+  seqlock_read(&m->fb_lock, &fb, &m->fb, sizeof(feedback_t));
+  if (fb.n_pos != m->fb_n_pos) {
+    point_set_xyz(m->position, fb.x, fb.y, fb.z);
+    m->fb_n_pos = fb.n_pos;
+    if (m->est && fb.pos_t) {
+      coord_t p[3] = {fb.x, fb.y, fb.z};
+      estimator_correct(m->est, fb.pos_seq, fb.pos_t, p, now_ns());
     }
   }
-  // Failed to connect
+  if (fb.n_err != m->fb_n_err) {
+    m->error = fb.error;
+    m->fb_n_err = fb.n_err;
+  }
+  if (fb.n_buf != m->fb_n_buf) {
+    m->credit_limit = fb.buf_seq + fb.buf_free;
+    m->flow = 1;
+    m->fb_n_buf = fb.n_buf;
+  }
+  if (fb.n_stats != m->fb_n_stats) {
+    m->last_stats = fb.stats;
+    m->fb_n_stats = fb.n_stats;
+  }
+  estimate_update(m);
+}
+
+// Latency-compensated position and error, once the estimator has a sample;
+// the last reported ones otherwise
+static void estimate_update(machine_t *m) {
+  coord_t p[3];
+  if (m->est && estimator_valid(m->est)) {
+    m->error_est = estimator_predict(m->est, now_ns(), p);
+    point_set_xyz(m->position_est, p[0], p[1], p[2]);
+  }
   else {
-    eprintf("-X Connection error: %s\n", mosquitto_connack_string(rc));
-    exit(EXIT_FAILURE);
+    point_set_xyz(m->position_est, point_x(m->position), point_y(m->position), point_z(m->position));
+    m->error_est = m->error;
   }
-  m->connecting = 0;
 }
 
-static void on_message(struct mosquitto *mqt, void *ud, const struct mosquitto_message *msg) {
-  machine_t *m = (machine_t *)ud;
-  // subtopic is the last word in the MQTT topic
-  // strrchr returns a pointer to the last occourrence of a given char
-  char *subtopic = strrchr(msg->topic, '/') + 1;
+// Full names of the incoming topics: the status topics share the sub_topic
+// prefix up to its last '/' (e.g. c-cnc/status/ for c-cnc/status/#)
+static void topics_resolve(machine_t *m) {
+  const char *names[] = {"position", "error", "buffer"};
+  const char *slash = strrchr(m->sub_topic, '/');
+  int prefix = slash ? (int)(slash - m->sub_topic) + 1 : 0;
+  int i;
+  for (i = TOPIC_POSITION; i <= TOPIC_BUFFER; i++) {
+    snprintf(m->topics[i].name, BUFLEN, "%.*s%s", prefix, m->sub_topic, names[i]);
+    m->topics[i].len = strlen(m->topics[i].name);
+  }
+  snprintf(m->topics[TOPIC_COMMAND].name, BUFLEN, "%s", m->cmd_topic);
+  m->topics[TOPIC_COMMAND].len = strlen(m->topics[TOPIC_COMMAND].name);
+}
 
-  eprintf("<- message: %s:%s\n", msg->topic, (char *)msg->payload);
-  mosquitto_message_copy(m->msg, msg);
+// Parse a decimal number (sign, digits, fraction, exponent) from [p, end),
+// without locale lookups nor a terminating null. Return value points past
+// the number, NULL if there are no digits
+static const char *parse_number(const char *p, const char *end, double *v) {
+  static const double pow10[] = {1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7,
+    1E8, 1E9, 1E10, 1E11, 1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19,
+    1E20, 1E21, 1E22};
+  uint64_t mant = 0;
+  int neg = 0, digits = 0, sig = 0, exp = 0, e = 0, eneg = 0;
 
-  // if the last topic part is "error", then take it as a single value
-  if (strcmp(subtopic, "error") == 0 ) {
-    m->error = atof(msg->payload);
+  while (p < end && *p == ' ') p++;
+  if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+  for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+    if (sig < 19) {
+      mant = mant * 10 + (*p - '0');
+      sig += (mant > 0);
+    }
+    else exp++;
   }
-  else if (strcmp(subtopic, "position") == 0) {
-    // we have to parse a string like "123.4,100.0,-98" into three
-    // coordinate values x, y, and z
-    char *nxt = msg->payload;
-    point_set_x(m->position, strtod(nxt, &nxt));
-    point_set_y(m->position, strtod(nxt+1, &nxt));
-    point_set_z(m->position, strtod(nxt+1, &nxt));
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+      if (sig < 19) {
+        mant = mant * 10 + (*p - '0');
+        sig += (mant > 0);
+        exp--;
+      }
+    }
   }
-  else {
-    eprintf("Got unexpected message on %s\n", msg->topic);
+  if (digits == 0) return NULL;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    if (p < end && (*p == '-' || *p == '+')) eneg = (*p++ == '-');
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      if (e < 1000) e = e * 10 + (*p - '0');
+    }
+  }
+  exp += eneg ? -e : e;
+  // exact powers of ten up to 1E22: dividing keeps the fraction exact
+  if (exp >= 0 && exp <= 22) *v = (double)mant * pow10[exp];
+  else if (exp < 0 && exp >= -22) *v = (double)mant / pow10[-exp];
+  else *v = (double)mant * pow(10, exp);
+  if (neg) *v = -*v;
+  return p;
+}
+
+// Unsigned decimal integer from [p, end). Return value points past the
+// number, NULL if there are no digits
+static const char *parse_uint(const char *p, const char *end, uint64_t *v) {
+  const char *start;
+  while (p < end && *p == ' ') p++;
+  for (*v = 0, start = p; p < end && *p >= '0' && *p <= '9'; p++) {
+    *v = *v * 10 + (*p - '0');
+  }
+  return p > start ? p : NULL;
+}
+
+// Round trip of setpoint seq, stamped at t by machine_sync(), and tracking
+// error: distance between that setpoint and the position reached once the
+// plant has applied it. Runs on the thread that publishes the setpoints,
+// which owns the history and the histograms
+static void track_update(machine_t *m, uint32_t seq, uint64_t t, const double pos[3]) {
+  const setpoint_msg_t *sp = &m->sent[seq % TRACK_LEN];
+  uint64_t now = now_ns();
+  data_t e;
+
+  // older than the history, or not a setpoint of ours (e.g. on replay)
+  if (sp->seq != seq || sp->t != t || t > now) return;
+  if (m->stats_t0 == 0) m->stats_t0 = now;
+  histogram_add(m->rtt, now - t);
+  e = sqrt(pow(sp->x - pos[0], 2) + pow(sp->y - pos[1], 2) + pow(sp->z - pos[2], 2));
+  histogram_add(m->track, (uint64_t)(e * 1E6));
+  if ((now - m->stats_t0) / 1E9 >= STATS_WINDOW) {
+    stats_close(m, now);
+  }
+}
+
+// Hand the window percentiles over to the control loop (and to stderr, if
+// stats is set), then start a new window
+static void stats_close(machine_t *m, uint64_t now) {
+  const data_t q[3] = {0.5, 0.99, 0.999};
+  machine_stats_t *s = &m->fb_shadow.stats;
+  int i;
+
+  s->n = histogram_count(m->rtt);
+  for (i = 0; i < 3; i++) {
+    s->rtt[i] = histogram_quantile(m->rtt, q[i]) / 1E6;
+    s->track[i] = histogram_quantile(m->track, q[i]) / 1E6;
+  }
+  m->fb_shadow.n_stats++;
+  if (m->stats) {
+    eprintf("RTT p50/p99/p99.9 %.3f/%.3f/%.3f ms, tracking error %.4f/%.4f/%.4f mm (%llu samples)\n",
+      s->rtt[0], s->rtt[1], s->rtt[2], s->track[0], s->track[1], s->track[2],
+      (unsigned long long)s->n);
+  }
+  histogram_merge(m->rtt_all, m->rtt);
+  histogram_merge(m->track_all, m->track);
+  histogram_reset(m->rtt);
+  histogram_reset(m->track);
+  m->stats_t0 = now;
+}
+
+// Queue a setpoint into the pending batch, publishing the batch once full
+// (in the configured payload format, see publish_flush())
+static void publish_setpoint(machine_t *m, const setpoint_msg_t *sp) {
+  m->sent[sp->seq % TRACK_LEN] = *sp;
+  m->batch_buf[m->batch_n++] = *sp;
+  if (m->batch_n == (size_t)m->batch) {
+    publish_flush(m, 1);
+  }
+}
+
+// Publish the pending batch, if forced or if its oldest setpoint has waited
+// for as long as a whole batch takes to fill at the nominal pace
+static void publish_flush(machine_t *m, int force) {
+  size_t len;
+  if (m->batch_n == 0) return;
+  if (!force && now_ns() - m->batch_buf[0].t < m->batch * m->tq * 1E9 / m->rt_pacing) {
+    return;
   }
-}
\ No newline at end of file
+  // fill up pub_buffer with the pending set points, in the configured format
+  len = setpoint_encode_batch(m->batch_buf, m->batch_n, m->payload, m->pub_buffer, m->pub_len);
+  // send buffer to the plant
+  transport_publish(m->tr, m->pub_topic, m->pub_buffer, len);
+  m->batch_n = 0;
+}
+
+// Publish a segment in binary form, on the setpoint topic
+static void publish_segment(machine_t *m, const segment_t *s) {
+  uint8_t buf[SEGMENT_LEN];
+  size_t len = segment_encode(s, buf, sizeof(buf));
+  transport_publish(m->tr, m->pub_topic, buf, len);
+}
+
+// Network I/O thread: drains the setpoint queue and polls the transport, so
+// that a slow broker never stalls the control loop
+static void *io_loop(void *arg) {
+  machine_t *m = (machine_t *)arg;
+  setpoint_msg_t sp;
+  segment_t seg;
+  while (atomic_load(&m->io_running)) {
+    while (spsc_pop(m->seg_queue, &seg) == 0) {
+      publish_segment(m, &seg);
+    }
+    while (spsc_pop(m->sp_queue, &sp) == 0) {
+      publish_setpoint(m, &sp);
+    }
+    publish_flush(m, 0);
+    if (transport_poll(m->tr, IO_LOOP_TIMEOUT)) {
+      perror("transport poll error");
+      usleep(IO_LOOP_TIMEOUT * 1000);
+    }
+  }
+  // do not lose the last setpoints and segments
+  while (spsc_pop(m->seg_queue, &seg) == 0) {
+    publish_segment(m, &seg);
+  }
+  while (spsc_pop(m->sp_queue, &sp) == 0) {
+    publish_setpoint(m, &sp);
+  }
+  publish_flush(m, 1);
+  return NULL;
+}
+
+// Stop and join the I/O thread, if running
+static void io_stop(machine_t *m) {
+  if (atomic_exchange(&m->io_running, 0)) {
+    pthread_join(m->io_thread, NULL);
+    if (m->sp_dropped)
+      eprintf("Dropped %zu setpoints on a full queue\n", m->sp_dropped);
+  }
+}
@@ -10,7 +10,8 @@
 
 #include "defines.h"
 #include "point.h"
-#include <mosquitto.h>
+#include "segment.h"
+#include "transport.h"
 
 //   _____                      
 //  |_   _|   _ _ __   ___  ___ 
@@ -22,6 +23,19 @@
 // Opaque struct
 typedef struct machine machine_t;
 
+// Max length of a command received on the command topic
+#define MACHINE_CMD_LEN 256
+
+// Rolling statistics over the last second, from plants that echo the
+// sequence number and timestamp of the setpoints with their position
+typedef struct {
+  uint64_t n;                   // samples in the window
+  data_t rtt[3];                // setpoint to position round trip, p50, p99
+                                // and p99.9 (ms)
+  data_t track[3];              // distance between a setpoint and the
+                                // position reached on it, same quantiles (mm)
+} machine_stats_t;
+
 //   _____                 _   _                 
 //  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___ 
 //  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
@@ -34,24 +48,45 @@ typedef struct machine machine_t;
 machine_t *machine_new(const char *ini_path);
 void machine_free(machine_t *m);
 
-// MQTT COMMUNICATIONS =========================================================
+// COMMUNICATIONS ==============================================================
+// Over the transport chosen in the [TRANSPORT] section of the INI file
 
-typedef void (* machine_on_message)(struct mosquitto *mqt, void *ud, const struct mosquitto_message *msg);
+typedef transport_on_message machine_on_message;
 
 int machine_connect(machine_t *m, machine_on_message callback);
 
 int machine_sync(machine_t *m, int rapid);
 
+// Velocity (mm/s) and acceleration (mm/s^2) sent along with the next
+// setpoint, if feed_forward is enabled
+void machine_set_derivatives(machine_t *m, const data_t v[3], const data_t a[3]);
+
+// Flow control: number of setpoints that can still be sent ahead of time,
+// given the buffer last reported by the plant on <sub_topic>/buffer as
+// "seq,free". Negative if the plant never reported (no flow control)
+int machine_credit(machine_t *m);
+
+// Segment streaming (stream = segments in the INI file): number s and send
+// it to the plant on pub_topic, instead of the setpoints; no-op otherwise
+int machine_stream(machine_t *m, segment_t *s);
+
 int machine_listen_start(machine_t *m);
 
 int machine_listen_stop(machine_t *m);
 
 void machine_listen_update(machine_t *m);
 
+// Pop the oldest command received on cmd_topic; returns 0 on success
+int machine_command(machine_t *m, char *cmd);
+
 void machine_disconnect(machine_t *m);
 
 // ACCESSORS ===================================================================
+// Getters are static inline with CCNC_INLINE (see machine_layout.h)
 
+#if defined(CCNC_INLINE) && !defined(MACHINE_IMPL)
+#include "machine_layout.h"
+#else
 data_t machine_A(const machine_t *m);
 
 data_t machine_tq(const machine_t *m);
@@ -68,8 +103,41 @@ point_t *machine_position(const machine_t *m);
 
 data_t machine_error(const machine_t *m);
 
+// Position and positioning error now, compensated for the feedback latency
+// ([C-CNC] estimator); the last reported ones if disabled, or until the
+// plant echoes a setpoint with its position
+point_t *machine_position_est(const machine_t *m);
+
+data_t machine_error_est(const machine_t *m);
+
+point_t *machine_rapid_v(const machine_t *m);
+
+data_t machine_rapid_settle(const machine_t *m);
+
+data_t machine_rapid_tol(const machine_t *m);
+
 data_t machine_rt_pacing(const machine_t *m);
 
+int machine_headless(const machine_t *m);
+
+int machine_simulate(const machine_t *m);
+
+int machine_segments(const machine_t *m);
+
+// 1 if setpoints carry velocity and acceleration ([MQTT] feed_forward)
+int machine_feed_forward(const machine_t *m);
+#endif
+
+// 1 if the estimated position is on the last setpoint, within max_error
+// (always 0 without an estimate)
+int machine_settled(const machine_t *m);
+
+// Shared memory name for the telemetry snapshot (NULL if disabled)
+const char *machine_telemetry(const machine_t *m);
+
+// Last window of round trip and tracking error statistics (n = 0 if none)
+const machine_stats_t *machine_stats(const machine_t *m);
+
 
 
 
@@ -0,0 +1,171 @@
+//   __  __            _     _              _                         _
+//  |  \/  | __ _  ___| |__ (_)_ __   ___  | | __ _ _   _  ___  _   _| |_
+//  | |\/| |/ _` |/ __| '_ \| | '_ \ / _ \ | |/ _` | | | |/ _ \| | | | __|
+//  | |  | | (_| | (__| | | | | | | |  __/ | | (_| | |_| | (_) | |_| | |_
+//  |_|  |_|\__,_|\___|_| |_|_|_| |_|\___| |_|\__,_|\__, |\___/ \__,_|\__|
+//                                                  |___/
+//  Layout of machine_t, and its getters as static inline functions for the
+//  hot paths (with CCNC_INLINE, see point_layout.h)
+
+#ifndef MACHINE_LAYOUT_H
+#define MACHINE_LAYOUT_H
+
+#include "machine.h"
+#include "histogram.h"
+#include "estimator.h"
+#include "lockfree.h"
+#include "setpoint.h"
+#include <pthread.h>
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+#define MACHINE_BUFLEN 1024
+
+// Topics handled by on_message(), resolved once from sub_topic and cmd_topic
+typedef enum {
+  TOPIC_POSITION = 0,
+  TOPIC_ERROR,
+  TOPIC_BUFFER,
+  TOPIC_COMMAND,
+  TOPIC_COUNT
+} topic_id_t;
+
+typedef struct {
+  char name[MACHINE_BUFLEN];    // full topic name
+  size_t len;                   // its length, 0 if unused
+} topic_entry_t;
+
+// Feedback snapshot, written by on_message and read by the control loop
+typedef struct {
+  coord_t x, y, z;              // last reported position
+  uint32_t pos_seq;             // setpoint echoed with the position, and
+  uint64_t pos_t;               // its timestamp (0 if not echoed)
+  data_t error;                 // last reported positioning error
+  uint32_t buf_seq, buf_free;   // plant buffer: last received seq, free slots
+  uint32_t n_pos, n_err, n_buf; // update counters for position, error, buffer
+  machine_stats_t stats;        // last closed statistics window
+  uint32_t n_stats;             // update counter for stats
+} feedback_t;
+
+// Machine object structure. The fields are grouped by the thread that uses
+// them, and by how often: each group starts on its own cache line (the
+// object is allocated aligned), so that the control loop finds what it
+// reads on every tick in a few lines, and does not share any with the
+// fields written by the I/O thread
+struct machine {
+  // hot: the control loop, every tick (machine_sync(), machine_credit(),
+  // feedback_read(), machine_command() and the getters of the state
+  // machine); what every mode reads first, then feed-forward and network
+  _Alignas(LF_CACHELINE)
+  data_t tq;                    // timestep
+  data_t A;                     // max acceleration
+  data_t max_error, error;      // max positioning error and actual error
+  data_t error_est;             // latency-compensated error (see position_est)
+  data_t rapid_settle;          // settling time after each rapid
+  data_t rt_pacing;
+  point_t *zero, *offset;       // machine reference zero and workpiece offset
+  point_t *setpoint, *position; // desired and actual position
+  point_t *position_est;        // latency-compensated position, the reported
+                                // one without an estimator
+  estimator_t *est;             // position estimator (optional)
+  transport_t *tr;
+  spsc_t *cmd_queue;            // commands received on cmd_topic
+  FILE *sink;                   // opened sim_sink, if any
+  uint32_t sp_seq;              // sequence number of the next setpoint
+  uint32_t credit_limit;        // last seq the plant has room for
+  int simulate;                 // no broker nor pacing, ideal local plant
+  int segments;                 // stream whole segments instead of setpoints
+  int threaded;                 // poll the transport in a dedicated thread
+  int feed_forward;             // setpoints carry velocity and acceleration
+  int flow;                     // the plant reports its buffer (flow control)
+  data_t sp_v[3], sp_a[3];      // feed-forward of the next setpoint
+  uint32_t fb_n_pos, fb_n_err, fb_n_buf, fb_n_stats; // counters of the last
+                                // applied snapshot
+  spsc_t *sp_queue;             // setpoints from control to I/O thread
+  size_t sp_dropped;            // setpoints lost on a full queue
+  // I/O: setpoints out and messages in, on the thread polling the transport
+  // (the I/O thread if threaded, else the control loop), with the round
+  // trip and tracking error statistics
+  _Alignas(LF_CACHELINE)
+  setpoint_msg_t *batch_buf;    // setpoints waiting to be published
+  size_t batch_n;               // number of setpoints in batch_buf
+  int batch;                    // setpoints per message
+  setpoint_format_t payload;    // setpoint payload format
+  char *pub_buffer;             // encoded payload
+  size_t pub_len;               // size of pub_buffer
+  atomic_int io_running;        // I/O thread keeps running while set
+  int debug;                    // 1 logs every incoming message
+  setpoint_msg_t *sent;         // last TRACK_LEN setpoints sent, by seq
+  histogram_t *rtt, *track;     // current window (ns, nm)
+  uint64_t stats_t0;            // start of the current window
+  feedback_t fb_shadow;         // writer-side copy of the snapshot
+  // feedback snapshot, from the I/O side to the control loop
+  _Alignas(LF_CACHELINE)
+  seqlock_t fb_lock;            // protects fb
+  feedback_t fb;                // shared feedback snapshot
+  // cold: configuration, connection and per-block or per-run data
+  _Alignas(LF_CACHELINE)
+  point_t *rapid_v;             // max axis velocities for rapids (mm/min)
+  data_t rapid_tol;             // path tolerance at rapid/feed junctions
+  uint32_t seg_seq;             // sequence number of the next segment
+  int headless;                 // no terminal: jobs and commands via MQTT
+  int stats;                    // 1 prints every window on stderr
+  machine_stats_t last_stats;   // last window, as seen by the control loop
+  histogram_t *rtt_all, *track_all; // whole run (ns, nm)
+  spsc_t *seg_queue;            // segments from control to I/O thread
+  pthread_t io_thread;          // network I/O thread
+  transport_cfg_t tcfg;         // transport backend and its parameters
+  topic_entry_t topics[TOPIC_COUNT]; // incoming topics, see topics_resolve()
+  char pub_topic[MACHINE_BUFLEN];
+  char sub_topic[MACHINE_BUFLEN];
+  char cmd_topic[MACHINE_BUFLEN]; // commands for headless mode (optional)
+  char sim_sink[MACHINE_BUFLEN]; // file collecting simulated setpoints
+  char telemetry[MACHINE_BUFLEN]; // shared memory name (optional)
+};
+
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+#if defined(CCNC_INLINE) && !defined(MACHINE_IMPL)
+
+// ACCESSORS ===================================================================
+
+#define machine_getter(typ, par)                                               \
+  static inline typ machine_##par(const machine_t *m) {                        \
+    assert(m);                                                                 \
+    return m->par;                                                             \
+  }
+
+machine_getter(data_t, A);
+machine_getter(data_t, tq);
+machine_getter(data_t, max_error);
+machine_getter(data_t, error);
+machine_getter(point_t *, zero);
+machine_getter(point_t *, offset);
+machine_getter(point_t *, setpoint);
+machine_getter(point_t *, position);
+machine_getter(point_t *, position_est);
+machine_getter(data_t, error_est);
+machine_getter(point_t *, rapid_v);
+machine_getter(data_t, rapid_settle);
+machine_getter(data_t, rapid_tol);
+machine_getter(data_t, rt_pacing);
+machine_getter(int, headless);
+machine_getter(int, simulate);
+machine_getter(int, segments);
+machine_getter(int, feed_forward);
+
+#undef machine_getter
+
+#endif
+
+#endif // MACHINE_LAYOUT_H
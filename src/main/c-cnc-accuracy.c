@@ -0,0 +1,128 @@
+//    ____       ____ _   _  ____
+//   / ___|     / ___| \ | |/ ___|   __ _  ___ ___ _   _ _ __ __ _  ___ _   _
+//  | |   _____| |   |  \| | |      / _` |/ __/ __| | | | '__/ _` |/ __| | | |
+//  | |__|_____| |___| |\  | |___  | (_| | (_| (__| |_| | | | (_| | (__| |_| |
+//   \____|     \____|_| \_|\____|  \__,_|\___\___|\__,_|_|  \__,_|\___|\__, |
+//                                                                      |___/
+// Accuracy report: compares a trajectory (the CSV written by c-cnc) with a
+// reference one, usually the same program run by a DATA_TYPE=double build.
+// The reference is interpolated at the times of the trajectory, so the two
+// need not be sampled on the same grid
+#include "../defines.h"
+#include "../inic.h"
+#include <unistd.h>
+
+#define eprintf(...) fprintf(stderr, __VA_ARGS__)
+#define BUFLEN 1024
+#define INI_FILE "settings.ini"
+
+typedef struct {
+  double t, x, y, z;
+} sample_t;
+
+static void usage(const char *name) {
+  eprintf("Usage: %s [-t tolerance] REFERENCE TRAJECTORY\n", name);
+  eprintf("  -t tolerance  max position deviation, mm (default from %s\n", INI_FILE);
+  eprintf("                [C-CNC] max_error)\n");
+  eprintf("Both files are c-cnc trajectories (n,t_tot,t_blk,lambda,s,feed,x,y,z).\n");
+  eprintf("Exit code is 0 if the deviation is within tolerance, 1 otherwise.\n");
+}
+
+// Read the samples of a trajectory file; return value is their number, 0
+// on error. *s must be freed by the caller
+static size_t load(const char *path, sample_t **s) {
+  char line[BUFLEN];
+  size_t n = 0, cap = 1024;
+  sample_t *p;
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return 0;
+  }
+  if (!(*s = (sample_t *)malloc(cap * sizeof(sample_t)))) {
+    perror("Error allocating samples");
+    exit(EXIT_FAILURE);
+  }
+  while (fgets(line, BUFLEN, f)) {
+    if (n == cap) {
+      cap *= 2;
+      if (!(p = (sample_t *)realloc(*s, cap * sizeof(sample_t)))) {
+        perror("Error allocating samples");
+        exit(EXIT_FAILURE);
+      }
+      *s = p;
+    }
+    p = *s + n;
+    // skips the header, and anything else that is not a sample
+    if (sscanf(line, "%*u,%lf,%*f,%*f,%*f,%*f,%lf,%lf,%lf",
+               &p->t, &p->x, &p->y, &p->z) == 4)
+      n++;
+  }
+  fclose(f);
+  if (n == 0) eprintf("No samples in %s\n", path);
+  return n;
+}
+
+int main(int argc, char *argv[]) {
+  sample_t *ref = NULL, *cur = NULL;
+  size_t n_ref, n_cur, i, j = 0;
+  double tol = -1, dx, dy, dz, d, d_max = 0, sum = 0, t_max = 0, w;
+  int c;
+  void *ini;
+
+  while ((c = getopt(argc, argv, "t:h")) != -1) {
+    switch (c) {
+    case 't': tol = atof(optarg); break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - optind != 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (tol < 0) {
+    if (!(ini = ini_init(INI_FILE)) ||
+        ini_get_double(ini, "C-CNC", "max_error", &tol)) {
+      eprintf("No tolerance given, and none in %s\n", INI_FILE);
+      return 1;
+    }
+    ini_free(ini);
+  }
+  if (!(n_ref = load(argv[optind], &ref)) ||
+      !(n_cur = load(argv[optind + 1], &cur)))
+    return 2;
+
+  // both are sorted by time: walk the reference along
+  for (i = 0; i < n_cur; i++) {
+    while (j + 1 < n_ref && ref[j + 1].t <= cur[i].t) j++;
+    if (j + 1 < n_ref && cur[i].t > ref[j].t) {
+      w = (cur[i].t - ref[j].t) / (ref[j + 1].t - ref[j].t);
+      dx = cur[i].x - (ref[j].x + w * (ref[j + 1].x - ref[j].x));
+      dy = cur[i].y - (ref[j].y + w * (ref[j + 1].y - ref[j].y));
+      dz = cur[i].z - (ref[j].z + w * (ref[j + 1].z - ref[j].z));
+    } else {
+      dx = cur[i].x - ref[j].x;
+      dy = cur[i].y - ref[j].y;
+      dz = cur[i].z - ref[j].z;
+    }
+    d = sqrt(dx * dx + dy * dy + dz * dz);
+    sum += d * d;
+    if (d > d_max) {
+      d_max = d;
+      t_max = cur[i].t;
+    }
+  }
+
+  printf("Samples:         %zu (reference %zu)\n", n_cur, n_ref);
+  printf("Cycle time:      %.6f s (reference %.6f s, %+.3g s)\n",
+         cur[n_cur - 1].t, ref[n_ref - 1].t, cur[n_cur - 1].t - ref[n_ref - 1].t);
+  printf("Deviation max:   %.3g mm at t = %.6f s\n", d_max, t_max);
+  printf("Deviation RMS:   %.3g mm\n", sqrt(sum / n_cur));
+  printf("Tolerance:       %.3g mm, %s\n", tol, d_max <= tol ? "PASS" : "FAIL");
+
+  free(ref);
+  free(cur);
+  return d_max <= tol ? 0 : 1;
+}
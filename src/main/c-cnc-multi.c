@@ -0,0 +1,75 @@
+//   __  __       _ _   _
+//  |  \/  |_   _| | |_(_)
+//  | |\/| | | | | | __| |
+//  | |  | | |_| | | |_| |
+//  |_|  |_|\__,_|_|\__|_|
+// Several C-CNC machines in one process, on a small thread pool
+#include "../defines.h"
+#include "../fsm_la.h"
+#include "../scheduler.h"
+#include <unistd.h>
+
+#define eprintf(...) fprintf(stderr, __VA_ARGS__)
+#define BUFLEN 1024
+
+static void usage(const char *name) {
+  eprintf("Usage: %s [-j threads] INI_FILE PROGRAM [INI_FILE PROGRAM ...]\n", name);
+  eprintf("Each machine needs its own INI file (topics, offsets...).\n");
+  eprintf("Trajectories are written to machine<N>.csv.\n");
+}
+
+int main(int argc, char *const argv[]) {
+  scheduler_t *sched = NULL;
+  ccnc_state_data_t *machines = NULL;
+  size_t i, n, n_threads = 1;
+  char out_name[BUFLEN];
+  int opt, rv = 0;
+
+  while ((opt = getopt(argc, argv, "j:h")) != -1) {
+    switch (opt) {
+    case 'j':
+      n_threads = atol(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((argc - optind) < 2 || (argc - optind) % 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  n = (argc - optind) / 2;
+
+  sched = scheduler_new(n_threads);
+  machines = (ccnc_state_data_t *)calloc(n, sizeof(ccnc_state_data_t));
+  if (!sched || !machines) {
+    eprintf("Could not allocate %zu machines\n", n);
+    return 2;
+  }
+  // every machine runs its own program once, unattended
+  for (i = 0; i < n; i++) {
+    machines[i].ini_file = argv[optind + 2 * i];
+    machines[i].prog_file = argv[optind + 2 * i + 1];
+    machines[i].headless = 1;
+    machines[i].run_jobs = 1;
+    machines[i].batch = 1;
+    snprintf(out_name, BUFLEN, "machine%zu.csv", i);
+    if (!(machines[i].out = fopen(out_name, "w"))) {
+      perror("Could not open trajectory file");
+      return 3;
+    }
+    scheduler_add(sched, &machines[i]);
+  }
+
+  eprintf("Running %zu machines on %zu threads\n", n, MIN(n_threads, n));
+  rv = scheduler_run(sched);
+  eprintf("All machines stopped, %zu late ticks\n", scheduler_overruns(sched));
+
+  for (i = 0; i < n; i++) {
+    fclose(machines[i].out);
+  }
+  free(machines);
+  scheduler_free(sched);
+  return rv;
+}
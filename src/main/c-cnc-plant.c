@@ -0,0 +1,200 @@
+//   ____  _             _
+//  |  _ \| | __ _ _ __ | |_
+//  | |_) | |/ _` | '_ \| __|
+//  |  __/| | (_| | | | | |_
+//  |_|   |_|\__,_|_| |_|\__|
+// Native plant simulator: receives setpoints (or segments) from c-cnc and
+// answers with the position, the error, and its buffer status
+#include "../defines.h"
+#include "../inic.h"
+#include "../plant.h"
+#include "../segment.h"
+#include "../setpoint.h"
+#include "../transport.h"
+#include <signal.h>
+#include <unistd.h>
+
+#define eprintf(...) fprintf(stderr, __VA_ARGS__)
+#define BUFLEN 1024
+#define MAX_BATCH 1024
+
+// Everything the message callback needs
+typedef struct {
+  plant_t *plant;
+  transport_t *tr;
+  FILE *out;                    // optional trajectory log
+  char pos_topic[BUFLEN], err_topic[BUFLEN], buf_topic[BUFLEN];
+  setpoint_msg_t batch[MAX_BATCH];
+  uint32_t last_seq;
+  uint64_t last_t;              // timestamp of the last setpoint, 0 for segments
+  size_t n_msg, n_sp;
+  data_t err_max, err_sq;
+} plant_data_t;
+
+static volatile sig_atomic_t _running = 1;
+
+static void on_signal(int sig) {
+  _running = 0;
+}
+
+static void usage(const char *name) {
+  eprintf("Usage: %s [-o CSV_FILE] [INI_FILE]\n", name);
+  eprintf("INI_FILE defaults to settings.ini; sections [PLANT], [TRANSPORT] and [MQTT]\n");
+  eprintf("are shared with c-cnc. Stop with Ctrl-C.\n");
+}
+
+// Advance the plant by one sampling time towards sp, with the feed-forward
+// v and acc if not NULL, and log the sample
+static void advance(plant_data_t *pd, const coord_t sp[3], const coord_t v[3], const coord_t acc[3]) {
+  coord_t xyz[3];
+  data_t e;
+  plant_step(pd->plant, sp, v, acc, plant_tq(pd->plant));
+  e = plant_error(pd->plant);
+  pd->err_max = MAX(pd->err_max, e);
+  pd->err_sq += e * e;
+  pd->n_sp++;
+  if (pd->out) {
+    plant_position(pd->plant, xyz);
+    fprintf(pd->out, "%f,%f,%f,%f,%f,%f,%f,%f\n", plant_time(pd->plant),
+      sp[0], sp[1], sp[2], xyz[0], xyz[1], xyz[2], e);
+  }
+}
+
+static void on_message(void *ud, const char *topic, const void *payload, size_t len) {
+  plant_data_t *pd = (plant_data_t *)ud;
+  coord_t sp[3];
+  data_t t, tq = plant_tq(pd->plant);
+  char buf[BUFLEN];
+  segment_t s;
+  size_t i, n;
+
+  pd->n_msg++;
+  if (len > 0 && ((const uint8_t *)payload)[0] == SEGMENT_MAGIC) {
+    if (segment_decode(payload, len, &s)) {
+      eprintf("Malformed segment on %s\n", topic);
+      return;
+    }
+    // sample the segment at the controller rate, from the current plant
+    // time to its end; before its start, it holds the initial point
+    while ((t = plant_time(pd->plant) + tq - s.t0) < s.dt + tq / 2) {
+      segment_eval(&s, t, sp, NULL);
+      advance(pd, sp, NULL, NULL);
+    }
+    pd->last_seq = s.seq;
+    pd->last_t = 0;
+  }
+  else {
+    n = setpoint_decode_batch(payload, len, pd->batch, MAX_BATCH);
+    if (n == 0) {
+      eprintf("Malformed setpoint on %s\n", topic);
+      return;
+    }
+    for (i = 0; i < n; i++) {
+      sp[0] = pd->batch[i].x;
+      sp[1] = pd->batch[i].y;
+      sp[2] = pd->batch[i].z;
+      if (pd->batch[i].flags & SETPOINT_FF)
+        advance(pd, sp, pd->batch[i].v, pd->batch[i].a);
+      else
+        advance(pd, sp, NULL, NULL);
+    }
+    pd->last_seq = pd->batch[n - 1].seq;
+    pd->last_t = pd->batch[n - 1].t;
+  }
+
+  // feedback: the position echoes the last setpoint applied, so that c-cnc
+  // can measure the round trip and the tracking error
+  plant_position(pd->plant, sp);
+  if (pd->last_t)
+    snprintf(buf, BUFLEN, "%f,%f,%f,%u,%llu", sp[0], sp[1], sp[2], pd->last_seq,
+      (unsigned long long)pd->last_t);
+  else
+    snprintf(buf, BUFLEN, "%f,%f,%f", sp[0], sp[1], sp[2]);
+  transport_publish(pd->tr, pd->pos_topic, buf, strlen(buf));
+  snprintf(buf, BUFLEN, "%f", plant_error(pd->plant));
+  transport_publish(pd->tr, pd->err_topic, buf, strlen(buf));
+  // setpoints are consumed on arrival: the whole buffer is always free
+  if (plant_buffer(pd->plant) > 0) {
+    snprintf(buf, BUFLEN, "%u,%d", pd->last_seq, plant_buffer(pd->plant));
+    transport_publish(pd->tr, pd->buf_topic, buf, strlen(buf));
+  }
+}
+
+int main(int argc, char *const argv[]) {
+  static plant_data_t pd = {0};
+  const char *ini_file = "settings.ini";
+  char pub_topic[BUFLEN], sub_topic[BUFLEN];
+  transport_cfg_t cfg;
+  uint64_t t0;
+  void *ini;
+  int opt, prefix, rc = 0;
+  char *slash;
+
+  while ((opt = getopt(argc, argv, "o:h")) != -1) {
+    switch (opt) {
+    case 'o':
+      if (!(pd.out = fopen(optarg, "w"))) {
+        perror("Could not open trajectory file");
+        return 1;
+      }
+      fprintf(pd.out, "t,x_sp,y_sp,z_sp,x,y,z,error\n");
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind < argc) ini_file = argv[optind];
+
+  // topics and transport are the same as c-cnc, seen from the other side
+  if (!(ini = ini_init(ini_file))) {
+    eprintf("Could not open the ini file %s\n", ini_file);
+    return 2;
+  }
+  transport_defaults(&cfg);
+  rc += ini_get_char(ini, "MQTT", "pub_topic", pub_topic, BUFLEN);
+  rc += ini_get_char(ini, "MQTT", "sub_topic", sub_topic, BUFLEN);
+  rc += transport_config(&cfg, ini);
+  ini_free(ini);
+  if (rc) {
+    eprintf("Missing/wrong %d config parameters\n", rc);
+    return 2;
+  }
+  slash = strrchr(sub_topic, '/');
+  prefix = slash ? (int)(slash - sub_topic) + 1 : 0;
+  snprintf(pd.pos_topic, BUFLEN, "%.*sposition", prefix, sub_topic);
+  snprintf(pd.err_topic, BUFLEN, "%.*serror", prefix, sub_topic);
+  snprintf(pd.buf_topic, BUFLEN, "%.*sbuffer", prefix, sub_topic);
+  cfg.plant = 1;
+  cfg.subs[0] = pub_topic;
+  cfg.subs[1] = NULL;
+
+  if (!(pd.plant = plant_new(ini_file))) {
+    eprintf("Could not create the plant\n");
+    return 3;
+  }
+  if (!(pd.tr = transport_new(&cfg, on_message, &pd)) || transport_connect(pd.tr)) {
+    eprintf("Could not connect the transport\n");
+    return 4;
+  }
+  eprintf("Plant listening on %s (%s transport)\n", pub_topic, transport_name(pd.tr));
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  t0 = now_ns();
+  while (_running) {
+    transport_poll(pd.tr, 10);
+  }
+
+  eprintf("\n%zu messages, %zu setpoints, %.3f s simulated in %.3f s\n",
+    pd.n_msg, pd.n_sp, plant_time(pd.plant), (now_ns() - t0) / 1E9);
+  if (pd.n_sp > 0) {
+    eprintf("Tracking error: max %.4f mm, RMS %.4f mm\n", pd.err_max,
+      sqrt(pd.err_sq / pd.n_sp));
+  }
+  transport_disconnect(pd.tr);
+  transport_free(pd.tr);
+  plant_free(pd.plant);
+  if (pd.out) fclose(pd.out);
+  return 0;
+}
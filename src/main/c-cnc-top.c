@@ -0,0 +1,110 @@
+//    ____       ____ _   _  ____   _
+//   / ___|     / ___| \ | |/ ___| | |_ ___  _ __
+//  | |   _____| |   |  \| | |     | __/ _ \| '_ \
+//  | |__|_____| |___| |\  | |___  | || (_) | |_) |
+//   \____|     \____|_| \_|\____|  \__\___/| .__/
+//                                          |_|
+// Telemetry monitor: samples the shared memory snapshot published by a
+// running c-cnc at its own rate, without interfering with the control loop
+#include "../defines.h"
+#include "../inic.h"
+#include "../telemetry.h"
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define eprintf(...) fprintf(stderr, __VA_ARGS__)
+#define BUFLEN 1024
+#define INI_FILE "settings.ini"
+
+static volatile sig_atomic_t _running = 1;
+
+static void on_signal(int sig) {
+  _running = 0;
+}
+
+static void usage(const char *name) {
+  eprintf("Usage: %s [-r rate] [-n count] [-c] [NAME]\n", name);
+  eprintf("  -r rate   samples per second (default 10)\n");
+  eprintf("  -n count  quit after count samples (default: until c-cnc quits)\n");
+  eprintf("  -c        CSV output, one line per sample\n");
+  eprintf("NAME is the shared memory object, default from %s [C-CNC] telemetry\n", INI_FILE);
+}
+
+static void print_csv(const telemetry_snapshot_t *s) {
+  printf("%llu,%s,%llu,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f\n",
+    (unsigned long long)s->tick, s->state, (unsigned long long)s->n,
+    s->t_tot, s->t_blk, s->lambda, s->feed, s->override,
+    s->setpoint[0], s->setpoint[1], s->setpoint[2],
+    s->position[0], s->position[1], s->position[2], s->error,
+    s->position_est[0], s->position_est[1], s->position_est[2], s->error_est,
+    s->period * 1E3, s->period_mean * 1E3, s->period_max * 1E3, s->late_max * 1E3);
+}
+
+// One status line, rewritten in place
+static void print_line(const telemetry_snapshot_t *s) {
+  printf("\r%-13s N%-5llu t %8.3f s  l %5.3f  F %7.1f (%3.0f%%)  "
+    "X %8.3f Y %8.3f Z %8.3f  err %6.3f (est %6.3f)  tick %6.3f/%6.3f/%6.3f ms ",
+    s->state, (unsigned long long)s->n, s->t_tot, s->lambda, s->feed,
+    s->override * 100,
+    s->position[0], s->position[1], s->position[2], s->error, s->error_est,
+    s->period * 1E3, s->period_mean * 1E3, s->period_max * 1E3);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  char name[BUFLEN] = "/c-cnc-telemetry";
+  telemetry_snapshot_t s;
+  telemetry_t *tel;
+  data_t rate = 10;
+  long count = -1;
+  int c, csv = 0;
+  uint32_t seq, last_seq = 0;
+  void *ini;
+
+  if ((ini = ini_init(INI_FILE))) {
+    char buf[BUFLEN];
+    if (ini_get_char(ini, "C-CNC", "telemetry", buf, BUFLEN) == 0 && buf[0])
+      snprintf(name, sizeof(name), "%s", buf);
+    ini_free(ini);
+  }
+  while ((c = getopt(argc, argv, "r:n:ch")) != -1) {
+    switch (c) {
+    case 'r': rate = atof(optarg); break;
+    case 'n': count = atol(optarg); break;
+    case 'c': csv = 1; break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind < argc) snprintf(name, sizeof(name), "%s", argv[optind]);
+  if (rate <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (!(tel = telemetry_open(name))) return 2;
+  signal(SIGINT, on_signal);
+  if (csv) {
+    printf("tick,state,n,t_tot,t_blk,lambda,feed,override,sp_x,sp_y,sp_z,x,y,z,error,"
+      "x_est,y_est,z_est,error_est,"
+      "period,period_mean,period_max,late_max\n");
+  }
+  while (_running && count != 0) {
+    seq = telemetry_read(tel, &s);
+    if (seq != last_seq) {
+      csv ? print_csv(&s) : print_line(&s);
+      last_seq = seq;
+      if (count > 0) count--;
+    }
+    // no news: quit if the writer is gone (the object is unlinked on exit,
+    // but this mapping stays valid)
+    else if (kill(telemetry_pid(tel), 0) && errno == ESRCH) {
+      break;
+    }
+    wait_next(1E9 / rate);
+  }
+  if (!csv) printf("\n");
+  telemetry_free(tel);
+  return 0;
+}
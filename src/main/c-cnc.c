@@ -4,10 +4,56 @@
 #include "../block_la.h"
 #include "../point.h"
 #include "../fsm_la.h"
+#include "../telemetry.h"
 
 #define eprintf(...) fprintf(stderr, __VA_ARGS__)
 
 #if 1
+// Loop timing, published with the telemetry
+typedef struct {
+  uint64_t ticks, last, sum;    // ticks, time of the last tick, sum of periods (ns)
+  uint64_t max, late_max;       // longest period, latest wake-up (ns)
+} loop_timing_t;
+
+// Fill in and publish the telemetry snapshot for the tick just run
+static void telemetry_update(telemetry_t *tel, ccnc_state_t state,
+                             ccnc_state_data_t *data, loop_timing_t *lt) {
+  telemetry_snapshot_t s = {0};
+  block_t *b = data->prog ? program_current(data->prog) : NULL;
+  machine_t *m = data->machine;
+  uint64_t now = now_ns(), period = lt->last ? now - lt->last : 0;
+
+  if (lt->last) {
+    lt->sum += period;
+    lt->max = MAX(lt->max, period);
+  }
+  lt->last = now;
+  strncpy(s.state, ccnc_state_names[state], TELEMETRY_STATE_LEN - 1);
+  s.tick = lt->ticks;
+  s.n = b ? block_n(b) : 0;
+  s.t_tot = data->t_tot;
+  s.t_blk = data->t_blk;
+  s.lambda = data->lambda;
+  s.feed = data->feed;
+  s.override = data->ovr ? override_value(data->ovr) : 1;
+  s.setpoint[0] = point_x(machine_setpoint(m));
+  s.setpoint[1] = point_y(machine_setpoint(m));
+  s.setpoint[2] = point_z(machine_setpoint(m));
+  s.position[0] = point_x(machine_position(m));
+  s.position[1] = point_y(machine_position(m));
+  s.position[2] = point_z(machine_position(m));
+  s.error = machine_error(m);
+  s.position_est[0] = point_x(machine_position_est(m));
+  s.position_est[1] = point_y(machine_position_est(m));
+  s.position_est[2] = point_z(machine_position_est(m));
+  s.error_est = machine_error_est(m);
+  s.period = period / 1E9;
+  s.period_mean = lt->ticks > 1 ? lt->sum / 1E9 / (lt->ticks - 1) : 0;
+  s.period_max = lt->max / 1E9;
+  s.late_max = lt->late_max / 1E9;
+  telemetry_write(tel, &s);
+}
+
 int main(int argc, char const *argv[]) {
   ccnc_state_data_t state_data = {
     .ini_file = "settings.ini",
@@ -16,11 +62,37 @@ int main(int argc, char const *argv[]) {
     .prog = NULL
   };
   ccnc_state_t cur_state = CCNC_STATE_INIT;
+  uint64_t t0 = 0, t1;
+  int simulate = 0;
+  telemetry_t *tel = NULL;
+  loop_timing_t lt = {0};
   do {
+    // throughput: motion ticks only, from the start of the first job
+    if (cur_state == CCNC_STATE_LOAD_BLOCK && !t0)
+      t0 = now_ns();
     cur_state = ccnc_run_state(cur_state, &state_data);
-    wait_next(machine_tq(state_data.machine) * 1E9 / machine_rt_pacing(state_data.machine));
+    if (!state_data.machine) continue;
+    // telemetry: created once the INI file has been read
+    if (!tel && !lt.ticks && machine_telemetry(state_data.machine)) {
+      tel = telemetry_new(machine_telemetry(state_data.machine));
+    }
+    lt.ticks++;
+    if (tel) telemetry_update(tel, cur_state, &state_data, &lt);
+    // simulation runs as fast as possible, without pacing
+    if ((simulate = machine_simulate(state_data.machine))) continue;
+    // flow control: run ahead while the plant has room in its buffer
+    if (ccnc_credit(&state_data) > 0) continue;
+    lt.late_max = MAX(lt.late_max, wait_next(machine_tq(state_data.machine) * 1E9 / machine_rt_pacing(state_data.machine)));
   } while (cur_state != CCNC_STATE_STOP);
+  t1 = now_ns();
+  // the stop state frees the machine
+  if (tel) telemetry_free(tel);
   ccnc_run_state(cur_state, &state_data);
+  if (simulate && state_data.setpoints) {
+    double dt = (t1 - t0) / 1E9;
+    eprintf("Simulated %llu motion ticks in %.3f s (%.0f ticks/s)\n",
+      (unsigned long long)state_data.setpoints, dt, state_data.setpoints / dt);
+  }
   return 0;
 }
 
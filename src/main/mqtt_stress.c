@@ -3,21 +3,103 @@
 //  \___ \| __| '__/ _ \/ __/ __| | __/ _ \/ __| __|
 //   ___) | |_| | |  __/\__ \__ \ | ||  __/\__ \ |_
 //  |____/ \__|_|  \___||___/___/  \__\___||___/\__|
-// MQTT Stress test
+// MQTT Stress test: N clients publish setpoint-shaped payloads at a target
+// rate, each one subscribed to its own topic, so that the broker echoes
+// every message back. Reports throughput, drops and end-to-end latency.
 #include "../defines.h"
 #include "../inic.h"
+#include "../histogram.h"
+#include "../setpoint.h"
+#include <mosquitto.h>
+#include <mqtt_protocol.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
 
 
-//   ____            _                 _   _                 
-//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___ 
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
 //  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
 //  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
 //  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
-// 
+//
 // preprocessor macros and constants
-
+#define eprintf(...) fprintf(stderr, __VA_ARGS__)
+#define BUFLEN 1024
+#define INI_FILE "settings.ini"
+#define MAX_PAYLOAD 65536
+#define DRAIN_TIME 2.0 // s, waiting for the last echoes
+#define SETUP_TIME 5.0 // s, waiting for connections and subscriptions
 
 // Custom types
+typedef struct {
+  char broker_addr[BUFLEN];
+  int broker_port;
+  char topic[BUFLEN];           // topic prefix, client i uses <topic>/<i>
+  int clients;
+  data_t rate;                  // messages/s, per client
+  size_t size;                  // payload size (bytes)
+  data_t duration;              // s
+  int qos;
+  setpoint_format_t format;
+  int v5;                       // MQTT v5, with a topic alias per client
+} options_t;
+
+// One client: sent and failed are written by the main thread, the other
+// counters by the network thread of the client
+typedef struct {
+  struct mosquitto *mqt;
+  char topic[BUFLEN + 16];      // <topic>/<i>
+  int qos;                      // of the echo subscription, as publishes
+  volatile int ready;           // connected and subscribed
+  int alias_max;                // topic aliases granted by the broker (v5)
+  mosquitto_property *alias;    // topic alias 1, once its topic is sent
+  uint32_t seq;                 // next seq to publish
+  uint64_t sent, failed;        // published, refused by the library
+  uint64_t received, reordered, malformed;
+  uint32_t last_seq;
+  histogram_t *latency;         // ns
+} client_t;
+
+// Functions
+static void on_connect(struct mosquitto *mqt, void *ud, int rc);
+static void on_connect_v5(struct mosquitto *mqt, void *ud, int rc, int flags, const mosquitto_property *props);
+static void on_subscribe(struct mosquitto *mqt, void *ud, int mid, int qos_len, const int *qos);
+static void on_message(struct mosquitto *mqt, void *ud, const struct mosquitto_message *msg);
+
+// global variable for controlling the main loop
+static volatile sig_atomic_t _running = 1;
+static void sig_handler(int signal) {
+  _running = 0;
+}
+
+static void usage(const char *name) {
+  eprintf("Usage: %s [options]\n", name);
+  eprintf("  -H host      broker address (default from %s [MQTT], or localhost)\n", INI_FILE);
+  eprintf("  -p port      broker port (default from %s [MQTT], or 1883)\n", INI_FILE);
+  eprintf("  -n clients   number of publishing clients (1)\n");
+  eprintf("  -r rate      messages per second, per client (200)\n");
+  eprintf("  -s size      payload size in bytes, padded from the setpoint (0: unpadded)\n");
+  eprintf("  -d seconds   test duration (10)\n");
+  eprintf("  -q qos       0, 1 or 2 (0)\n");
+  eprintf("  -t topic     topic prefix (c-cnc/stress)\n");
+  eprintf("  -f format    json, binary64 or binary32 (binary64)\n");
+  eprintf("  -5           MQTT v5, the topic is sent once, then as an alias\n");
+}
+
+// Sleep until the absolute time t (ns, as now_ns()); the last 100 us are
+// spent spinning, for accuracy
+static void sleep_until(uint64_t t) {
+  uint64_t now;
+  struct timespec ts;
+  while ((now = now_ns()) < t) {
+    if (t - now > 100000) {
+      ts.tv_sec = 0;
+      ts.tv_nsec = (long)(t - now - 100000);
+      nanosleep(&ts, NULL);
+    }
+  }
+}
 
 
 //                   _
@@ -26,7 +108,262 @@
 //  | | | | | | (_| | | | | |
 //  |_| |_| |_|\__,_|_|_| |_|
 //
-int main(int argc, char const *argv[]) {
-  // code here
-  return 0;
+int main(int argc, char *const argv[]) {
+  options_t opt = {
+    .broker_addr = "localhost",
+    .broker_port = 1883,
+    .topic = "c-cnc/stress",
+    .clients = 1,
+    .rate = 200,
+    .size = 0,
+    .duration = 10,
+    .qos = 0,
+    .format = SETPOINT_BINARY64
+  };
+  client_t *clients = NULL;
+  histogram_t *latency = NULL;
+  setpoint_msg_t sp = {0};
+  char *payload = NULL;
+  uint64_t t0, t_end, k, n_total, late = 0;
+  uint64_t sent = 0, failed = 0, received = 0, reordered = 0, malformed = 0;
+  data_t dt, period;
+  size_t len, buflen;
+  void *ini;
+  int i, c, rc = 0;
+
+  // broker defaults from the INI file, if any
+  if ((ini = ini_init(INI_FILE))) {
+    char addr[BUFLEN];
+    int port;
+    if (ini_get_char(ini, "MQTT", "broker_addr", addr, BUFLEN) == 0)
+      snprintf(opt.broker_addr, BUFLEN, "%s", addr);
+    if (ini_get_int(ini, "MQTT", "broker_port", &port) == 0)
+      opt.broker_port = port;
+    ini_free(ini);
+  }
+  while ((c = getopt(argc, argv, "H:p:n:r:s:d:q:t:f:5h")) != -1) {
+    switch (c) {
+    case 'H': snprintf(opt.broker_addr, BUFLEN, "%s", optarg); break;
+    case 'p': opt.broker_port = atoi(optarg); break;
+    case 'n': opt.clients = atoi(optarg); break;
+    case 'r': opt.rate = atof(optarg); break;
+    case 's': opt.size = (size_t)atol(optarg); break;
+    case 'd': opt.duration = atof(optarg); break;
+    case 'q': opt.qos = atoi(optarg); break;
+    case 't': snprintf(opt.topic, BUFLEN, "%s", optarg); break;
+    case '5': opt.v5 = 1; break;
+    case 'f':
+      if ((rc = setpoint_format(optarg)) < 0) {
+        eprintf("Unknown format %s\n", optarg);
+        return 1;
+      }
+      opt.format = (setpoint_format_t)rc;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (opt.clients < 1 || opt.rate <= 0 || opt.duration <= 0 ||
+      opt.qos < 0 || opt.qos > 2 || opt.size > MAX_PAYLOAD) {
+    usage(argv[0]);
+    return 1;
+  }
+  // JSON payloads are padded with spaces, up to what the decoder accepts
+  if (opt.format == SETPOINT_JSON && opt.size >= SETPOINT_JSON_LEN) {
+    opt.size = SETPOINT_JSON_LEN - 1;
+    eprintf("JSON payloads limited to %zu bytes\n", opt.size);
+  }
+
+  // MQTT
+  if (mosquitto_lib_init() != MOSQ_ERR_SUCCESS) {
+    perror("Could not initialize MQTT library");
+    return 2;
+  }
+  clients = (client_t *)calloc(opt.clients, sizeof(client_t));
+  buflen = MAX(opt.size, SETPOINT_JSON_LEN);
+  payload = (char *)malloc(buflen);
+  latency = histogram_new();
+  if (!clients || !payload) {
+    perror("Could not allocate clients");
+    return 2;
+  }
+  signal(SIGINT, sig_handler);
+
+  // one connection per client, each with its own network thread
+  for (i = 0; i < opt.clients; i++) {
+    client_t *cl = &clients[i];
+    snprintf(cl->topic, sizeof(cl->topic), "%s/%d", opt.topic, i);
+    cl->qos = opt.qos;
+    cl->latency = histogram_new();
+    if (!(cl->mqt = mosquitto_new(NULL, 1, cl))) {
+      perror("Could not create MQTT object");
+      return 3;
+    }
+    mosquitto_subscribe_callback_set(cl->mqt, on_subscribe);
+    mosquitto_message_callback_set(cl->mqt, on_message);
+    if (opt.v5) {
+      mosquitto_int_option(cl->mqt, MOSQ_OPT_PROTOCOL_VERSION, MQTT_PROTOCOL_V5);
+      mosquitto_connect_v5_callback_set(cl->mqt, on_connect_v5);
+      rc = mosquitto_connect_bind_v5(cl->mqt, opt.broker_addr, opt.broker_port, 60, NULL, NULL);
+    }
+    else {
+      mosquitto_connect_callback_set(cl->mqt, on_connect);
+      rc = mosquitto_connect(cl->mqt, opt.broker_addr, opt.broker_port, 60);
+    }
+    if (rc != MOSQ_ERR_SUCCESS) {
+      eprintf("Could not connect to %s:%d: %s\n", opt.broker_addr, opt.broker_port, mosquitto_strerror(rc));
+      return 4;
+    }
+    if (mosquitto_loop_start(cl->mqt) != MOSQ_ERR_SUCCESS) {
+      eprintf("Could not start the network thread\n");
+      return 4;
+    }
+  }
+  // wait for every client to be subscribed
+  t0 = now_ns();
+  for (i = 0; i < opt.clients && _running; i++) {
+    while (!clients[i].ready && _running) {
+      if ((now_ns() - t0) / 1E9 > SETUP_TIME) {
+        eprintf("Client %d not ready after %.0f s\n", i, SETUP_TIME);
+        return 5;
+      }
+      usleep(1000);
+    }
+  }
+  eprintf("%d clients on %s:%d, %.0f msg/s each, %zu bytes, QoS %d, for %.1f s%s\n",
+    opt.clients, opt.broker_addr, opt.broker_port, opt.rate,
+    MAX(opt.size, setpoint_encode(&sp, opt.format, payload, buflen)),
+    opt.qos, opt.duration, opt.v5 ? ", MQTT v5" : "");
+
+  // open-loop load: message k is due at t0 + k * period, round robin over
+  // the clients; when behind schedule, messages go out back to back
+  period = 1E9 / (opt.rate * opt.clients);
+  n_total = (uint64_t)(opt.duration * opt.rate * opt.clients);
+  t0 = now_ns();
+  for (k = 0; k < n_total && _running; k++) {
+    client_t *cl = &clients[k % opt.clients];
+    uint64_t due = t0 + (uint64_t)(k * period);
+    if (now_ns() > due + (uint64_t)period) late++;
+    sleep_until(due);
+    sp.seq = cl->seq++;
+    sp.x = sp.y = sp.z = (coord_t)k;
+    sp.t = now_ns();
+    len = setpoint_encode(&sp, opt.format, payload, buflen);
+    if (len < opt.size) {
+      memset(payload + len, opt.format == SETPOINT_JSON ? ' ' : 0, opt.size - len);
+      len = opt.size;
+    }
+    if (!opt.v5 || cl->alias_max == 0)
+      rc = mosquitto_publish(cl->mqt, NULL, cl->topic, (int)len, payload, opt.qos, 0);
+    else if (!cl->alias) {
+      mosquitto_property_add_int16(&cl->alias, MQTT_PROP_TOPIC_ALIAS, 1);
+      rc = mosquitto_publish_v5(cl->mqt, NULL, cl->topic, (int)len, payload, opt.qos, 0, cl->alias);
+    }
+    else
+      rc = mosquitto_publish_v5(cl->mqt, NULL, NULL, (int)len, payload, opt.qos, 0, cl->alias);
+    if (rc == MOSQ_ERR_SUCCESS)
+      cl->sent++;
+    else
+      cl->failed++;
+  }
+  t_end = now_ns();
+  dt = (t_end - t0) / 1E9;
+
+  // let the last echoes come back
+  for (i = 0; i < opt.clients; i++) {
+    sent += clients[i].sent;
+  }
+  while ((now_ns() - t_end) / 1E9 < DRAIN_TIME) {
+    for (received = 0, i = 0; i < opt.clients; i++) {
+      received += clients[i].received;
+    }
+    if (received >= sent) break;
+    usleep(10000);
+  }
+  for (i = 0; i < opt.clients; i++) {
+    mosquitto_disconnect(clients[i].mqt);
+    mosquitto_loop_stop(clients[i].mqt, 0);
+    mosquitto_destroy(clients[i].mqt);
+    mosquitto_property_free_all(&clients[i].alias);
+  }
+  mosquitto_lib_cleanup();
+
+  // Report
+  received = 0;
+  for (i = 0; i < opt.clients; i++) {
+    failed += clients[i].failed;
+    received += clients[i].received;
+    reordered += clients[i].reordered;
+    malformed += clients[i].malformed;
+    histogram_merge(latency, clients[i].latency);
+    histogram_free(clients[i].latency);
+  }
+  printf("Published: %llu in %.3f s (%.0f msg/s, target %.0f), %llu refused, %llu late\n",
+    (unsigned long long)sent, dt, sent / dt, opt.rate * opt.clients,
+    (unsigned long long)failed, (unsigned long long)late);
+  printf("Received:  %llu (%.0f msg/s), %llu dropped (%.3f%%), %llu reordered, %llu malformed\n",
+    (unsigned long long)received, received / dt,
+    (unsigned long long)(sent > received ? sent - received : 0),
+    sent ? 100.0 * (sent > received ? sent - received : 0) / sent : 0.0,
+    (unsigned long long)reordered, (unsigned long long)malformed);
+  histogram_print(latency, stdout, "Latency (us)", 1E3);
+
+  histogram_free(latency);
+  free(payload);
+  free(clients);
+  return sent > 0 && received == 0 ? 6 : 0;
+}
+
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+static void on_connect(struct mosquitto *mqt, void *ud, int rc) {
+  client_t *cl = (client_t *)ud;
+  if (rc != CONNACK_ACCEPTED) {
+    eprintf("Connection refused: %s\n", mosquitto_connack_string(rc));
+    return;
+  }
+  mosquitto_subscribe(mqt, NULL, cl->topic, cl->qos);
+}
+
+static void on_connect_v5(struct mosquitto *mqt, void *ud, int rc, int flags, const mosquitto_property *props) {
+  client_t *cl = (client_t *)ud;
+  uint16_t max = 0;
+  mosquitto_property_read_int16(props, MQTT_PROP_TOPIC_ALIAS_MAXIMUM, &max, false);
+  cl->alias_max = max;
+  on_connect(mqt, ud, rc);
+}
+
+static void on_subscribe(struct mosquitto *mqt, void *ud, int mid, int qos_len, const int *qos) {
+  client_t *cl = (client_t *)ud;
+  cl->ready = 1;
+}
+
+// Latency is from the timestamp in the payload to now
+static void on_message(struct mosquitto *mqt, void *ud, const struct mosquitto_message *msg) {
+  client_t *cl = (client_t *)ud;
+  uint64_t now = now_ns();
+  setpoint_msg_t sp;
+  size_t len = (size_t)msg->payloadlen;
+
+  // JSON padding is not part of the setpoint
+  if (len > 0 && ((char *)msg->payload)[0] == '{') {
+    char *end = memchr(msg->payload, '}', len);
+    if (end) len = end - (char *)msg->payload + 1;
+  }
+  if (setpoint_decode(msg->payload, len, &sp)) {
+    cl->malformed++;
+    return;
+  }
+  if (cl->received > 0 && (int32_t)(sp.seq - cl->last_seq) <= 0)
+    cl->reordered++;
+  else
+    cl->last_seq = sp.seq;
+  cl->received++;
+  histogram_add(cl->latency, now > sp.t ? now - sp.t : 0);
 }
@@ -0,0 +1,211 @@
+//   _   _      _      _                     _
+//  | |_(_) ___| | __ | |__   ___ _ __   ___| |__
+//  | __| |/ __| |/ / | '_ \ / _ \ '_ \ / __| '_ \
+//  | |_| | (__|   <  | |_) |  __/ | | | (__| | | |
+//   \__|_|\___|_|\_\ |_.__/ \___|_| |_|\___|_| |_|
+//
+// Cost of a control loop tick: runs a program through the state machine,
+// unattended and without pacing ([C-CNC] simulate = 1), and reports time
+// and, where the kernel exposes them, hardware counters per motion tick
+// (a tick spent in the rapid or interpolation state). Compare builds with
+// and without INLINE_ACCESSORS to see the cost of the getter calls.
+// Between ticks a paced controller sleeps, and the rest of the system runs:
+// -e flushes the caches before each tick by writing through a buffer, so
+// that the cache misses are those of a tick starting cold, which is what the
+// layout of the hot structs (see *_layout.h) is about.
+#include "../defines.h"
+#include "../fsm_la.h"
+#include "../lockfree.h"
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define eprintf(...) fprintf(stderr, __VA_ARGS__)
+
+// Hardware counters, opened as one group so that they count the same ticks
+typedef struct {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+  int fd;                       // -1 if not available
+  uint64_t value;
+} counter_t;
+
+#ifdef __linux__
+#define L1D_READ_MISS (PERF_COUNT_HW_CACHE_L1D | \
+  (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+static counter_t _counters[] = {
+  {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0},
+  {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0},
+  {"L1d misses", PERF_TYPE_HW_CACHE, L1D_READ_MISS, -1, 0},
+  {"cache refs", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, -1, 0},
+  {"cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, 0},
+};
+#else
+static counter_t _counters[] = {
+  {"instructions", 0, 0, -1, 0},
+  {"cycles", 0, 0, -1, 0},
+  {"L1d misses", 0, 0, -1, 0},
+  {"cache refs", 0, 0, -1, 0},
+  {"cache misses", 0, 0, -1, 0},
+};
+#endif
+#define N_COUNTERS (sizeof(_counters) / sizeof(_counters[0]))
+
+// Open the counters of this thread, user space only; return value is the
+// number opened
+static size_t counters_open(void) {
+  size_t i, n = 0;
+#ifdef __linux__
+  struct perf_event_attr attr;
+  int leader = -1;
+  for (i = 0; i < N_COUNTERS; i++) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = _counters[i].type;
+    attr.config = _counters[i].config;
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    _counters[i].fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+    if (_counters[i].fd < 0) continue;
+    if (leader < 0) leader = _counters[i].fd;
+    n++;
+  }
+#endif
+  return n;
+}
+
+static void counters_enable(int on) {
+#ifdef __linux__
+  size_t i;
+  for (i = 0; i < N_COUNTERS; i++) {
+    if (_counters[i].fd < 0) continue;
+    ioctl(_counters[i].fd, on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE,
+          PERF_IOC_FLAG_GROUP);
+    return; // the leader
+  }
+#endif
+}
+
+static void counters_close(void) {
+  size_t i;
+  for (i = 0; i < N_COUNTERS; i++) {
+    if (_counters[i].fd < 0) continue;
+    if (read(_counters[i].fd, &_counters[i].value, sizeof(uint64_t)) != sizeof(uint64_t)) {
+      close(_counters[i].fd);
+      _counters[i].fd = -1;
+      continue;
+    }
+    close(_counters[i].fd);
+  }
+}
+
+// Write through buf, evicting the rest from the caches up to its size
+static void evict(uint8_t *buf, size_t len) {
+  size_t i;
+  for (i = 0; i < len; i += LF_CACHELINE) buf[i]++;
+}
+
+static void usage(const char *name) {
+  eprintf("Usage: %s [-n runs] [-e KiB] [-i INI_FILE] PROGRAM\n", name);
+  eprintf("  -n runs      run the program this many times (default 10)\n");
+  eprintf("  -e KiB       flush the caches before each tick, writing through\n");
+  eprintf("               KiB of memory (more than the last level cache)\n");
+  eprintf("  -i INI_FILE  settings, with [C-CNC] simulate = 1 (default settings.ini)\n");
+}
+
+int main(int argc, char *argv[]) {
+  char *ini_file = "settings.ini";
+  long runs = 10, r;
+  uint8_t *buf = NULL;
+  size_t buf_len = 0;
+  uint64_t ticks = 0, t, ns = 0;
+  ccnc_state_t state;
+  char label[32];
+  size_t i;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:e:i:h")) != -1) {
+    switch (c) {
+    case 'n': runs = atol(optarg); break;
+    case 'e': buf_len = atol(optarg) * 1024; break;
+    case 'i': ini_file = optarg; break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - optind != 1 || runs < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (buf_len && !(buf = (uint8_t *)calloc(buf_len, 1))) {
+    perror("Could not allocate the eviction buffer");
+    return 2;
+  }
+  if (counters_open() == 0)
+    eprintf("Hardware counters not available, timing only\n");
+
+  for (r = 0; r < runs; r++) {
+    ccnc_state_data_t data = {
+      .ini_file = ini_file,
+      .prog_file = argv[optind],
+      .headless = 1,
+      .run_jobs = 1,
+      .batch = 1,
+    };
+    if (!(data.out = fopen("/dev/null", "w"))) {
+      perror("Could not open /dev/null");
+      return 2;
+    }
+    state = CCNC_STATE_INIT;
+    do {
+      if (data.machine && !machine_simulate(data.machine)) {
+        eprintf("%s: set [C-CNC] simulate = 1\n", ini_file);
+        return 2;
+      }
+      if (state != CCNC_STATE_RAPID_MOTION && state != CCNC_STATE_INTERP_MOTION) {
+        state = ccnc_run_state(state, &data);
+        continue;
+      }
+      if (buf) evict(buf, buf_len);
+      t = now_ns();
+      counters_enable(1);
+      state = ccnc_run_state(state, &data);
+      counters_enable(0);
+      ns += now_ns() - t;
+      ticks++;
+    } while (state != CCNC_STATE_STOP);
+    ccnc_run_state(state, &data);
+    fclose(data.out);
+  }
+  counters_close();
+  free(buf);
+  if (ticks == 0) {
+    eprintf("No motion in %s\n", argv[optind]);
+    return 3;
+  }
+
+  printf("Getters:       %s\n",
+#ifdef CCNC_INLINE
+         "inline"
+#else
+         "out of line"
+#endif
+  );
+  printf("Motion ticks:  %llu (%ld runs, %s)\n", (unsigned long long)ticks, runs,
+         buf ? "cold caches" : "warm caches");
+  printf("Time:          %.1f ns/tick\n", (double)ns / ticks);
+  for (i = 0; i < N_COUNTERS; i++) {
+    snprintf(label, sizeof(label), "%s:", _counters[i].name);
+    if (_counters[i].fd < 0)
+      printf("%-15sn/a\n", label);
+    else
+      printf("%-15s%.1f/tick\n", label, (double)_counters[i].value / ticks);
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+//    ___                      _     _
+//   / _ \__   _____ _ __ _ __(_) __| | ___
+//  | | | \ \ / / _ \ '__| '__| |/ _` |/ _ \
+//  | |_| |\ V /  __/ |  | |  | | (_| |  __/
+//   \___/  \_/ \___|_|  |_|  |_|\__,_|\___|
+
+#include "override.h"
+#include "inic.h"
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+#define ADAPT_ONSET 0.5         // fraction of the limit where k starts falling
+#define ADAPT_FALL 4.0          // falling rate, relative to the rising rate
+
+typedef struct override {
+  data_t limit;                 // positioning error limit (mm), 0 if disabled
+  data_t k_min;                 // lowest adaptive factor
+  data_t rate;                  // max rising rate of k (1/s)
+  data_t A;                     // max acceleration (mm/s^2)
+  data_t user;                  // manual override, 0 to OVERRIDE_MAX
+  int hold;                     // feed hold
+  data_t k;                     // current factor
+} override_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+override_t *override_new(const char *ini_path) {
+  override_t *o = (override_t *)calloc(1, sizeof(override_t));
+  if (!o) {
+    perror("Error creating override object");
+    exit(EXIT_FAILURE);
+  }
+  o->limit = 0;
+  o->k_min = 0.2;
+  o->rate = 1;
+  o->A = 125;
+  o->user = 1;
+  if (ini_path) {
+    void *ini = ini_init(ini_path);
+    if (!ini) {
+      eprintf("Could not open the ini file %s\n", ini_path);
+      free(o);
+      return NULL;
+    }
+    ini_get_opt_data_t(ini, "C-CNC", "A", &o->A);
+    ini_get_opt_data_t(ini, "C-CNC", "adapt_error", &o->limit);
+    ini_get_opt_data_t(ini, "C-CNC", "adapt_min", &o->k_min);
+    ini_get_opt_data_t(ini, "C-CNC", "adapt_rate", &o->rate);
+    ini_free(ini);
+    if (o->limit < 0 || o->k_min <= 0 || o->k_min > 1 || o->rate <= 0) {
+      eprintf("Wrong adaptive override parameters\n");
+      free(o);
+      return NULL;
+    }
+  }
+  override_reset(o);
+  return o;
+}
+
+void override_free(override_t *o) {
+  assert(o);
+  free(o);
+}
+
+// ALGORITHMS ==================================================================
+
+data_t override_update(override_t *o, data_t error, data_t feed, data_t acc, data_t k_max, data_t dt) {
+  assert(o);
+  data_t r, target = 1, lo = -INFINITY, hi = INFINITY;
+
+  if (o->limit > 0) {
+    r = error / o->limit;
+    if (r >= 1) {
+      target = o->k_min;
+    }
+    else if (r > ADAPT_ONSET) {
+      target = 1 - (1 - o->k_min) * (r - ADAPT_ONSET) / (1 - ADAPT_ONSET);
+    }
+    // a hold always brakes as hard as allowed
+    if (!o->hold) {
+      lo = -ADAPT_FALL * o->rate;
+      hi = o->rate;
+    }
+  }
+  target = o->hold ? 0 : MIN(target * o->user, k_max);
+  // the path accelerates by f*dk/dt + k^2*acc: at most A either way. When
+  // k overshoots the profile limit (by less than a tick), that is not
+  // feasible: hold k rather than pushing it further away
+  if (feed > 0) {
+    lo = MAX(lo, MIN((-o->A - o->k * o->k * acc) / feed, 0));
+    hi = MIN(hi, MAX((o->A - o->k * o->k * acc) / feed, 0));
+  }
+  o->k = MAX(0, MAX(o->k + lo * dt, MIN(target, o->k + hi * dt)));
+  return o->k;
+}
+
+void override_set(override_t *o, data_t user) {
+  assert(o);
+  o->user = MAX(0, MIN(user, OVERRIDE_MAX));
+}
+
+void override_hold(override_t *o, int hold) {
+  assert(o);
+  o->hold = hold;
+}
+
+// A new program starts at rest, so the manual override applies at once
+void override_reset(override_t *o) {
+  assert(o);
+  o->hold = 0;
+  o->k = MIN(o->user, 1);
+}
+
+// ACCESSORS ===================================================================
+
+data_t override_value(const override_t *o) { assert(o); return o->k; }
+data_t override_user(const override_t *o) { assert(o); return o->user; }
+int override_held(const override_t *o) { assert(o); return o->hold && o->k == 0; }
+int override_adaptive(const override_t *o) { assert(o); return o->limit > 0; }
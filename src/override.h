@@ -0,0 +1,87 @@
+//    ___                      _     _
+//   / _ \__   _____ _ __ _ __(_) __| | ___
+//  | | | \ \ / / _ \ '__| '__| |/ _` |/ _ \
+//  | |_| |\ V /  __/ |  | |  | | (_| |  __/
+//   \___/  \_/ \___|_|  |_|  |_|\__,_|\___|
+//  Feed override: a factor k that scales the motion speed. The FSM advances
+//  the block timer by k*tq on each tick, which replans the remaining
+//  profile at k times the feedrate and k^2 times the acceleration, with no
+//  jump in position or speed as long as k changes smoothly: it costs the
+//  same at every tick, whatever the look-ahead.
+//  The target of k is the product of:
+//    - the manual override, 0 to OVERRIDE_MAX
+//    - the adaptive override, which lowers k when the measured positioning
+//      error approaches a limit, and raises it back when the error falls:
+//      1 below half the limit, then linearly down to k_min at the limit
+//  and is 0 during a feed hold. k follows the target as fast as the
+//  acceleration A allows, given the feed and the acceleration of the
+//  profile; with the adaptive override, also no faster than adapt_rate (four
+//  times that when falling), except when holding. The caller bounds k as
+//  the profile requires (see block_override_limit()).
+
+#ifndef OVERRIDE_H
+#define OVERRIDE_H
+
+#include "defines.h"
+
+#define OVERRIDE_MAX 2.0
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque struct
+typedef struct override override_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+// Create a new override from the [C-CNC] section of an INI file (A, and the
+// optional adapt_error, adapt_min, adapt_rate). If the INI file is not given
+// (NULL), the adaptive override is disabled
+override_t *override_new(const char *ini_path);
+void override_free(override_t *o);
+
+// ALGORITHMS ==================================================================
+
+// Update the override for a tick of dt seconds, given the last measured
+// positioning error (mm), the programmed feed and acceleration at this
+// point of the profile, before the override (mm/s, mm/s^2), and the highest
+// factor the profile allows now; return value is the new factor
+data_t override_update(override_t *o, data_t error, data_t feed, data_t acc, data_t k_max, data_t dt);
+
+// Set the manual override (1 is the programmed feed), clamped to
+// 0-OVERRIDE_MAX; it is reached gradually
+void override_set(override_t *o, data_t user);
+
+// Engage (1) or release (0) the feed hold: k goes to 0, braking at A, and
+// back to its target on release
+void override_hold(override_t *o, int hold);
+
+// At the start of a program: release the hold, and apply the manual
+// override at once
+void override_reset(override_t *o);
+
+// ACCESSORS ===================================================================
+
+// Current factor
+data_t override_value(const override_t *o);
+
+// Manual override
+data_t override_user(const override_t *o);
+
+// 1 if holding, and at rest
+int override_held(const override_t *o);
+
+// 1 if the adaptive override is enabled
+int override_adaptive(const override_t *o);
+
+#endif // OVERRIDE_H
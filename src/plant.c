@@ -0,0 +1,252 @@
+//   ____  _             _
+//  |  _ \| | __ _ _ __ | |_
+//  | |_) | |/ _` | '_ \| __|
+//  |  __/| | (_| | | | | |_
+//  |_|   |_|\__,_|_| |_|\__|
+
+#include "plant.h"
+#include "inic.h"
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+// Motor torque curve, as in MATLAB/Cartesian3DPrinter.m
+static const data_t _curve_rpm[] = {0, 1000, 2000, 3000};
+static const data_t _curve_torque[] = {200, 200, 190, 0}; // Nm
+
+// One axis, in SI units
+typedef struct {
+  data_t m_eq;                  // moving mass plus reflected inertia (kg)
+  data_t kp, ki, kd;            // PID gains (N/m, N/(m s), N s/m)
+  coord_t x;                    // position (m)
+  data_t v;                     // velocity (m/s)
+  data_t integral;              // integral of the position error (m s)
+} axis_t;
+
+typedef struct plant {
+  data_t h;                     // integration step (s)
+  data_t pitch;                 // lead screw pitch (m/rev)
+  data_t friction;              // viscous friction (N s/m)
+  data_t tq;                    // controller sampling time (s)
+  int buffer;                   // setpoints announced as buffered
+  axis_t axis[3];
+  coord_t sp[3];                // last setpoint (m)
+  coord_t t;                    // simulated time (s)
+} plant_t;
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static void axis_init(axis_t *a, data_t mass, data_t j, data_t pitch, data_t friction, data_t bandwidth);
+static void axis_step(axis_t *a, coord_t sp, data_t v, data_t acc, data_t pitch, data_t friction, data_t h);
+static data_t max_torque(data_t rpm);
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+plant_t *plant_new(const char *ini_path) {
+  plant_t *p = (plant_t *)calloc(1, sizeof(plant_t));
+  // moving masses from MATLAB/sm_3d_printer_parameters.m: x carries the
+  // head and its bracket, y the sliding block with the whole x axis, z the
+  // printing bed
+  data_t mass[3] = {0.881, 5.257, 7.775};
+  // rotor inertia of the motor (Motor), and of the screws (Screw_x,
+  // Screw_y, screw_z) around their axes
+  data_t j_motor = 5.078e-4, j_screw[3] = {6.731e-5, 1.097e-4, 4.587e-5};
+  data_t pitch = 10, friction = 50, bandwidth = 20;
+  double zero[3] = {0}, offset[3] = {0}, tq;
+  int i;
+
+  if (!p) {
+    perror("Error creating plant object");
+    exit(EXIT_FAILURE);
+  }
+  p->h = 1E-4;
+  p->tq = 0.005;
+  if (ini_path) { // load values from INI file, [PLANT] is optional
+    void *ini = ini_init(ini_path);
+    int rc = 0;
+    if (!ini) {
+      eprintf("Could not open the ini file %s\n", ini_path);
+      free(p);
+      return NULL;
+    }
+    rc += ini_get_double(ini, "C-CNC", "tq", &tq);
+    p->tq = tq;
+    rc += ini_get_double(ini, "C-CNC", "origin_x", &zero[0]);
+    rc += ini_get_double(ini, "C-CNC", "origin_y", &zero[1]);
+    rc += ini_get_double(ini, "C-CNC", "origin_z", &zero[2]);
+    rc += ini_get_double(ini, "C-CNC", "offset_x", &offset[0]);
+    rc += ini_get_double(ini, "C-CNC", "offset_y", &offset[1]);
+    rc += ini_get_double(ini, "C-CNC", "offset_z", &offset[2]);
+    ini_get_opt_data_t(ini, "PLANT", "dt", &p->h);
+    ini_get_opt_data_t(ini, "PLANT", "pitch", &pitch);
+    ini_get_opt_data_t(ini, "PLANT", "mass_x", &mass[0]);
+    ini_get_opt_data_t(ini, "PLANT", "mass_y", &mass[1]);
+    ini_get_opt_data_t(ini, "PLANT", "mass_z", &mass[2]);
+    ini_get_opt_data_t(ini, "PLANT", "j_motor", &j_motor);
+    ini_get_opt_data_t(ini, "PLANT", "j_screw_x", &j_screw[0]);
+    ini_get_opt_data_t(ini, "PLANT", "j_screw_y", &j_screw[1]);
+    ini_get_opt_data_t(ini, "PLANT", "j_screw_z", &j_screw[2]);
+    ini_get_opt_data_t(ini, "PLANT", "friction", &friction);
+    ini_get_opt_data_t(ini, "PLANT", "bandwidth", &bandwidth);
+    ini_get_opt_int(ini, "PLANT", "buffer", &p->buffer);
+    ini_free(ini);
+    if (rc > 0 || p->h <= 0 || pitch <= 0 || bandwidth <= 0) {
+      eprintf("Missing/wrong %d config parameters\n", MAX(rc, 1));
+      free(p);
+      return NULL;
+    }
+  }
+  p->pitch = pitch / 1000.0;
+  p->friction = friction;
+  for (i = 0; i < 3; i++) {
+    axis_init(&p->axis[i], mass[i], j_motor + j_screw[i], p->pitch, friction, bandwidth);
+    p->axis[i].x = p->sp[i] = (zero[i] + offset[i]) / 1000.0;
+  }
+  return p;
+}
+
+void plant_free(plant_t *p) {
+  assert(p);
+  free(p);
+}
+
+// ALGORITHMS ==================================================================
+
+void plant_step(plant_t *p, const coord_t sp[3], const coord_t v[3], const coord_t acc[3], data_t dt) {
+  assert(p && sp);
+  int i, k, n = (int)ceil(dt / p->h - 1E-9);
+  data_t h, tau, vr, ar;
+  coord_t r;
+
+  if (n <= 0) return;
+  h = dt / n;
+  for (i = 0; i < 3; i++) {
+    p->sp[i] = sp[i] / 1000.0;
+    for (k = 0; k < n; k++) {
+      // with feed-forward, the reference moves along the path and reaches
+      // sp at the end of the step; otherwise sp is held for the whole step
+      if (v && acc) {
+        tau = dt - (k + 1) * h;
+        vr = (v[i] - acc[i] * tau) / 1000.0;
+        ar = acc[i] / 1000.0;
+        r = p->sp[i] - (v[i] * tau - acc[i] * pow(tau, 2) / 2.0) / 1000.0;
+      }
+      else {
+        r = p->sp[i];
+        vr = ar = 0;
+      }
+      axis_step(&p->axis[i], r, vr, ar, p->pitch, p->friction, h);
+    }
+  }
+  p->t += dt;
+}
+
+void plant_position(const plant_t *p, coord_t xyz[3]) {
+  assert(p && xyz);
+  int i;
+  for (i = 0; i < 3; i++) {
+    xyz[i] = p->axis[i].x * 1000.0;
+  }
+}
+
+data_t plant_error(const plant_t *p) {
+  assert(p);
+  data_t e2 = 0;
+  int i;
+  for (i = 0; i < 3; i++) {
+    e2 += pow(p->sp[i] - p->axis[i].x, 2);
+  }
+  return sqrt(e2) * 1000.0;
+}
+
+// ACCESSORS ===================================================================
+
+coord_t plant_time(const plant_t *p) { assert(p); return p->t; }
+data_t plant_tq(const plant_t *p) { assert(p); return p->tq; }
+int plant_buffer(const plant_t *p) { assert(p); return p->buffer; }
+
+
+//   ____  _        _   _         __
+//  / ___|| |_ __ _| |_(_) ___   / _|_   _ _ __   ___
+//  \___ \| __/ _` | __| |/ __| | |_| | | | '_ \ / __|
+//   ___) | || (_| | |_| | (__  |  _| |_| | | | | (__
+//  |____/ \__\__,_|\__|_|\___| |_|  \__,_|_| |_|\___|
+
+// Rotating inertias are reflected onto the axis through the screw; the PID
+// gains place the three closed-loop poles in -2*pi*bandwidth
+static void axis_init(axis_t *a, data_t mass, data_t j, data_t pitch, data_t friction, data_t bandwidth) {
+  data_t wn = 2 * M_PI * bandwidth;
+  a->m_eq = mass + j * pow(2 * M_PI / pitch, 2);
+  a->kp = 3 * a->m_eq * pow(wn, 2);
+  a->ki = a->m_eq * pow(wn, 3);
+  a->kd = MAX(3 * a->m_eq * wn - friction, 0);
+}
+
+// PID with derivative on the measurement, so that setpoint steps do not
+// kick; the reference velocity v and acceleration acc (both 0 without
+// feed-forward) add the force that the ideal motion needs. The motor torque
+// saturates following the torque curve, and the integral is frozen
+// meanwhile (anti-windup). Semi-implicit Euler
+static void axis_step(axis_t *a, coord_t sp, data_t v, data_t acc, data_t pitch, data_t friction, data_t h) {
+  data_t e = sp - a->x;
+  data_t force = a->kp * e + a->ki * a->integral + a->kd * (v - a->v) +
+    a->m_eq * acc + friction * v;
+  data_t torque = force * pitch / (2 * M_PI);
+  data_t limit = max_torque(fabs(a->v) / pitch * 60.0);
+
+  if (fabs(torque) > limit) {
+    torque = copysign(limit, torque);
+  }
+  else {
+    a->integral += e * h;
+  }
+  force = torque * 2 * M_PI / pitch;
+  a->v += (force - friction * a->v) / a->m_eq * h;
+  a->x += a->v * h;
+}
+
+// Available torque at the given speed, linear between the curve points
+static data_t max_torque(data_t rpm) {
+  size_t i, n = sizeof(_curve_rpm) / sizeof(_curve_rpm[0]);
+  for (i = 1; i < n; i++) {
+    if (rpm < _curve_rpm[i]) {
+      return _curve_torque[i - 1] + (_curve_torque[i] - _curve_torque[i - 1]) *
+        (rpm - _curve_rpm[i - 1]) / (_curve_rpm[i] - _curve_rpm[i - 1]);
+    }
+  }
+  return _curve_torque[n - 1];
+}
+
+
+//   _____ _____ ____ _____   __  __       _
+//  |_   _| ____/ ___|_   _| |  \/  | __ _(_)_ __
+//    | | |  _| \___ \ | |   | |\/| |/ _` | | '_ \
+//    | | | |___ ___) || |   | |  | | (_| | | | | |
+//    |_| |_____|____/ |_|   |_|  |_|\__,_|_|_| |_|
+// Only needed for testing purpose. To enable, compile as:
+// clang src/plant.c src/inic.cpp -o plant -lstdc++ -lm -DPLANT_MAIN
+#ifdef PLANT_MAIN
+int main() {
+  // step response of all axes, 1 mm each
+  plant_t *p = plant_new(NULL);
+  coord_t sp[3] = {1, 1, 1}, xyz[3];
+  int k;
+
+  printf("t,x,y,z,error\n");
+  for (k = 0; k < 40; k++) {
+    plant_step(p, sp, NULL, NULL, plant_tq(p));
+    plant_position(p, xyz);
+    printf("%f,%f,%f,%f,%f\n", plant_time(p), xyz[0], xyz[1], xyz[2], plant_error(p));
+  }
+  plant_free(p);
+  return 0;
+}
+#endif
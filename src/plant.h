@@ -0,0 +1,67 @@
+//   ____  _             _
+//  |  _ \| | __ _ _ __ | |_
+//  | |_) | |/ _` | '_ \| __|
+//  |  __/| | (_| | | | | |_
+//  |_|   |_|\__,_|_| |_|\__|
+//  Native model of the cartesian printer (see MATLAB/Cartesian3DPrinter.m),
+//  standing in for the Simulink simulation.
+//  Each axis is a moving mass on a lead screw. A motor drives the screw,
+//  with the torque/speed curve of the Simulink model, and a PID controls
+//  the position. Plant time only advances through plant_step(), so the
+//  model runs as fast as it is fed.
+
+#ifndef PLANT_H
+#define PLANT_H
+
+#include "defines.h"
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque struct
+typedef struct plant plant_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+// Create a new plant from the [PLANT] section of an INI file, starting at
+// the machine origin plus the workpiece offset (from [C-CNC]). If the INI
+// file is not given (NULL), use the default parameters
+plant_t *plant_new(const char *ini_path);
+void plant_free(plant_t *p);
+
+// ALGORITHMS ==================================================================
+
+// Advance the plant by dt seconds towards the setpoint sp (x, y, z in mm).
+// With the feed-forward velocity v (mm/s) and acceleration acc (mm/s^2),
+// the reference follows the path during the step; if they are NULL, sp is
+// held
+void plant_step(plant_t *p, const coord_t sp[3], const coord_t v[3], const coord_t acc[3], data_t dt);
+
+// Current head position in mm
+void plant_position(const plant_t *p, coord_t xyz[3]);
+
+// Euclidean distance between the last setpoint and the head position (mm)
+data_t plant_error(const plant_t *p);
+
+// ACCESSORS ===================================================================
+
+// Simulated time (s)
+coord_t plant_time(const plant_t *p);
+
+// Controller sampling time (s), from [C-CNC] tq
+data_t plant_tq(const plant_t *p);
+
+// Setpoints the plant announces it can buffer, 0 for no flow control
+int plant_buffer(const plant_t *p);
+
+#endif // PLANT_H
@@ -4,7 +4,9 @@
 //  |  __/ (_) | | | | | |_ 
 //  |_|   \___/|_|_| |_|\__|
 
-#include "point.h"
+// this file defines the out-of-line getters
+#define POINT_IMPL
+#include "point_layout.h"
 
 //   ____            _                 _   _                 
 //  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___ 
@@ -13,19 +15,6 @@
 //  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
                                                           
 
-// Point object struct
-// We are using a bitmask for encoding the coordinates that are left
-// undefined.
-// 0000 0000 => none set (0)
-// 0000 0001 => x is set (1)
-// 0000 0010 => y is set (2)
-// 0000 0100 => z is set (3)
-// 0000 0111 => xyz set (7)
-typedef struct point {
-  data_t x, y, z;
-  uint8_t s;
-} point_t;
-
 // Mnemonics for bitmask settings
 #define X_SET '\1'
 #define Y_SET '\2'
@@ -106,7 +95,7 @@ void point_inspect(const point_t *p, char **desc) {
 // 0000 0001 Char value of 1: '\1'
 // --------- bitwise or
 // xxxx xxx1 Result
-void point_set_x(point_t *p, data_t x) {
+void point_set_x(point_t *p, coord_t x) {
   assert(p);
   p->x = x;
   // | is the bitwise or, & is the bitwise and
@@ -117,7 +106,7 @@ void point_set_x(point_t *p, data_t x) {
 // 0000 0010 Char value of 2: '\2'
 // --------- bitwise or
 // xxxx xx1x Result
-void point_set_y(point_t *p, data_t y) {
+void point_set_y(point_t *p, coord_t y) {
   assert(p);
   p->y = y;
   // | is the bitwise or, & is the bitwise and
@@ -128,26 +117,26 @@ void point_set_y(point_t *p, data_t y) {
 // 0000 0100 Char value of 4: '\4'
 // --------- bitwise or
 // xxxx x1xx Result (x means "either 0 or 1")
-void point_set_z(point_t *p, data_t z) {
+void point_set_z(point_t *p, coord_t z) {
   assert(p);
   p->z = z;
   // | is the bitwise or, & is the bitwise and
   p->s |= Z_SET; // like in a = a + 1 => a += 1
 }
 // GETTERS
-data_t point_x(const point_t *p) { assert(p); return p->x; }
-data_t point_y(const point_t *p) { assert(p); return p->y; }
-data_t point_z(const point_t *p) { assert(p); return p->z; }
+coord_t point_x(const point_t *p) { assert(p); return p->x; }
+coord_t point_y(const point_t *p) { assert(p); return p->y; }
+coord_t point_z(const point_t *p) { assert(p); return p->z; }
 #else
 
 // Metaprogramming macro for DRYing the code
 #define point_accessor(axis, bitmask)              \
-  void point_set_##axis(point_t *p, data_t value) {\
+  void point_set_##axis(point_t *p, coord_t value) {\
     assert(p);                                     \
     p->axis = value;                               \
     p->s |= bitmask;                               \
   }                                                \
-  data_t point_##axis(const point_t *p) {          \
+  coord_t point_##axis(const point_t *p) {         \
     assert(p);                                     \
     return p->axis;                                \
   }
@@ -165,7 +154,7 @@ point_accessor(z, Z_SET);
 // 0000 0111 Char value of 7: '\7'
 // --------- bitwise or
 // xxxx x111 Result (x means "either 0 or 1")
-void point_set_xyz(point_t *p, data_t x, data_t y, data_t z) {
+void point_set_xyz(point_t *p, coord_t x, coord_t y, coord_t z) {
   assert(p);
   p->x = x;
   p->y = y;
@@ -180,11 +169,8 @@ void point_set_xyz(point_t *p, data_t x, data_t y, data_t z) {
 // distance between two points
 data_t point_dist(const point_t *from, const point_t *to) {
   assert(from && to);
-  return sqrt(
-    pow(to->x - from->x, 2) +
-    pow(to->y - from->y, 2) +
-    pow(to->z - from->z, 2)
-  );
+  coord_t dx = to->x - from->x, dy = to->y - from->y, dz = to->z - from->z;
+  return sqrt(dx * dx + dy * dy + dz * dz);
 }
 
 // Projections
@@ -193,6 +179,11 @@ void point_delta(const point_t *from, const point_t *to, point_t *delta) {
   point_set_xyz(delta, to->x - from->x, to->y - from->y, to->z - from->z);
 }
 
+void point_vec4(const point_t *p, vec4_t *v) {
+  assert(p && v);
+  vec4_set(v, p->x, p->y, p->z);
+}
+
 // Modal behavior: only import coordinates from previous point when these are
 // NOT DEFINED in current point and DEFINED in previous point
 void point_modal(const point_t *from, point_t *to) {
@@ -9,6 +9,7 @@
 #define POINT_H
 
 #include "defines.h"
+#include "vec4.h"
 
 //   _____                      
 //  |_   _|   _ _ __   ___  ___ 
@@ -43,15 +44,20 @@ void point_inspect(const point_t *p, char **desc);
 // ACCESSORS ===================================================================
 
 // Set coordinates
-void point_set_x(point_t *p, data_t val);
-void point_set_y(point_t *p, data_t val);
-void point_set_z(point_t *p, data_t val);
-void point_set_xyz(point_t *p, data_t x, data_t y, data_t z);
+void point_set_x(point_t *p, coord_t val);
+void point_set_y(point_t *p, coord_t val);
+void point_set_z(point_t *p, coord_t val);
+void point_set_xyz(point_t *p, coord_t x, coord_t y, coord_t z);
 
 // GETTERS
-data_t point_x(const point_t *p);
-data_t point_y(const point_t *p);
-data_t point_z(const point_t *p);
+// static inline with CCNC_INLINE (see point_layout.h)
+#if defined(CCNC_INLINE) && !defined(POINT_IMPL)
+#include "point_layout.h"
+#else
+coord_t point_x(const point_t *p);
+coord_t point_y(const point_t *p);
+coord_t point_z(const point_t *p);
+#endif
 
 // COMPUTATION =================================================================
 
@@ -61,6 +67,9 @@ data_t point_dist(const point_t *from, const point_t *to);
 // Projections
 void point_delta(const point_t *from, const point_t *to, point_t *delta);
 
+// Packed copy, for the array kernels in vec4.h
+void point_vec4(const point_t *p, vec4_t *v);
+
 // "Modal behavior": a point may have undefined coordinates and if so it
 // must be able ti inherit undefined coordinates from the previous point
 void point_modal(const point_t *from, point_t *to);
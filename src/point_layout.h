@@ -0,0 +1,53 @@
+//   ____       _       _     _                         _
+//  |  _ \ ___ (_)_ __ | |_  | | __ _ _   _  ___  _   _| |_
+//  | |_) / _ \| | '_ \| __| | |/ _` | | | |/ _ \| | | | __|
+//  |  __/ (_) | | | | | |_  | | (_| | |_| | (_) | |_| | |_
+//  |_|   \___/|_|_| |_|\__| |_|\__,_|\__, |\___/ \__,_|\__|
+//                                    |___/
+//  Layout of point_t, and its getters as static inline functions for the
+//  hot paths (with CCNC_INLINE, see INLINE_ACCESSORS in CMakeLists.txt).
+//  Code built so depends on the layout below, and must be rebuilt together
+//  with the library whenever it changes. Without CCNC_INLINE, point.h keeps
+//  the opaque, out-of-line getters, which the library always exports.
+
+#ifndef POINT_LAYOUT_H
+#define POINT_LAYOUT_H
+
+#include "point.h"
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Point object struct
+// We are using a bitmask for encoding the coordinates that are left
+// undefined.
+// 0000 0000 => none set (0)
+// 0000 0001 => x is set (1)
+// 0000 0010 => y is set (2)
+// 0000 0100 => z is set (3)
+// 0000 0111 => xyz set (7)
+struct point {
+  coord_t x, y, z;
+  uint8_t s;
+};
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+#if defined(CCNC_INLINE) && !defined(POINT_IMPL)
+
+// GETTERS
+static inline coord_t point_x(const point_t *p) { assert(p); return p->x; }
+static inline coord_t point_y(const point_t *p) { assert(p); return p->y; }
+static inline coord_t point_z(const point_t *p) { assert(p); return p->z; }
+
+#endif
+
+#endif // POINT_LAYOUT_H
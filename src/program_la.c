@@ -21,6 +21,7 @@ typedef struct program {
   FILE *file;                      // file handle
   block_t *first, *last, *current; // block pointers
   size_t n;                        // total number of blocks
+  coord_t min[3], max[3];          // bounding box of the targets
 } program_t;
 
 
@@ -147,51 +148,57 @@ void program_reset(program_t *p) {
   p->current = NULL;
 }
 
+// plan the velocity profiles, block by block: each block needs the
+// previous one already planned
+// return either EXIT_SUCCESS or EXIT_FAILURE
 int program_parse(program_t *p){
   assert(p);
-  program_reset(p);
-  block_t *b = program_next(p);
-  
-
-  while (b != NULL){
-    
-    if(block_velocity(b)){
-      fprintf(stderr, "ERROR: parsing the block\n");
-      return EXIT_FAILURE;}
-    b = program_next(p);
-
-
+  block_t *b;
+  vec4_t *v, min, max;
+  data_t *alpha;
+  size_t i;
+
+  // geometry of the whole program, on packed copies of the points: the
+  // cosines of the junctions (between the deltas of each block and of the
+  // next one; NaN after the last one) and the bounding box of the targets
+  v = vec4_alloc(p->n);
+  alpha = (data_t *)malloc(MAX(p->n, 1) * sizeof(data_t));
+  if (!alpha) {
+    perror("Could not allocate the junction cosines");
+    free(v);
+    return EXIT_FAILURE;
   }
-
-}
-
-
-void program_velocity(program_t *p){
-  assert(p);
+  for (i = 0, b = p->first; b; b = block_next(b), i++) {
+    point_vec4(block_delta(b), &v[i]);
+  }
+  alpha[MAX(p->n, 1) - 1] = NAN;
+  if (p->n > 1) vec4_cos(v, v + 1, alpha, p->n - 1);
+  for (i = 0, b = p->first; b; b = block_next(b), i++) {
+    point_vec4(block_target(b), &v[i]);
+  }
+  vec4_bbox(v, p->n, &min, &max);
+  p->min[0] = min.x; p->min[1] = min.y; p->min[2] = min.z;
+  p->max[0] = max.x; p->max[1] = max.y; p->max[2] = max.z;
+  free(v);
+
+  // backward pass: feasible junction feedrates
+  for (i = p->n, b = p->last; b; b = block_prev(b)) {
+    block_lookahead(b, alpha[--i]);
+  }
+  free(alpha);
+  // forward pass: velocity profiles
   program_reset(p);
-  block_t *b = program_next(p);
-
-  while (b!= NULL){
-
-    if(block_velocity(b)){
-      fprintf(stderr , "ERROR: parsing the block\n");
+  while ((b = program_next(p)) != NULL) {
+    if (block_parse(b)) {
+      fprintf(stderr, "ERROR: planning the block %s\n", block_line(b));
       return EXIT_FAILURE;
     }
-    b = program_next(p);
   }
-}
-
-void program_acc(program_t *p){
-  assert(p);
   program_reset(p);
-  block_t *b = program_next(p);
-
-  while( b!= NULL){
-
-    if(block_acc)
-  }
+  return EXIT_SUCCESS;
 }
 
+
 //_                    _ 
 //  | |    ___   ___ | | __      __ _| |__   ___  __ _  __| |
 //  | |   / _ \ / _ \| |/ /____ / _` | '_ \ / _ \/ _` |/ _` |
@@ -245,6 +252,12 @@ program_getter(block_t *, current, current);
 program_getter(block_t *, last, last);
 program_getter(size_t, n, length);
 
+void program_extent(const program_t *p, coord_t min[3], coord_t max[3]) {
+  assert(p && min && max);
+  memcpy(min, p->min, sizeof(p->min));
+  memcpy(max, p->max, sizeof(p->max));
+}
+
 
 
 
@@ -62,6 +62,9 @@ block_t *program_current(const program_t *p);
 block_t *program_first(const program_t *p);
 block_t *program_last(const program_t *p);
 
+// Bounding box of the block targets, once parsed with program_parse()
+void program_extent(const program_t *p, coord_t min[3], coord_t max[3]);
+
 
 
 //  | |    ___   ___ | | __      __ _| |__   ___  __ _  __| |
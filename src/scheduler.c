@@ -0,0 +1,204 @@
+//   ____       _              _       _
+//  / ___|  ___| |__   ___  __| |_   _| | ___ _ __
+//  \___ \ / __| '_ \ / _ \/ _` | | | | |/ _ \ '__|
+//   ___) | (__| | | |  __/ (_| | |_| | |  __/ |
+//  |____/ \___|_| |_|\___|\__,_|\__,_|_|\___|_|
+
+#include "scheduler.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+// One machine under scheduling
+typedef struct {
+  ccnc_state_data_t *data; // FSM state data
+  ccnc_state_t state;      // current FSM state
+  uint64_t deadline;       // time of the next tick (ns)
+  uint64_t period;         // tick period (ns), known once the machine exists
+  int done;                // FSM reached the stop state
+} sched_slot_t;
+
+// Scheduler object structure
+typedef struct scheduler {
+  sched_slot_t *slots;     // machines
+  size_t n, cap;           // number of machines and allocated slots
+  size_t n_threads;        // worker threads
+  atomic_size_t overruns;  // late ticks, all machines
+} scheduler_t;
+
+// Worker thread argument: worker id serves machines id, id+n_threads, ...
+typedef struct {
+  scheduler_t *s;
+  size_t id;
+} sched_worker_t;
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static void *sched_worker(void *arg);
+static void sched_tick(scheduler_t *s, sched_slot_t *slot);
+static void sleep_until(uint64_t t);
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+scheduler_t *scheduler_new(size_t n_threads) {
+  scheduler_t *s = (scheduler_t *)calloc(1, sizeof(scheduler_t));
+  if (!s) {
+    perror("Could not create scheduler");
+    return NULL;
+  }
+  s->n_threads = n_threads > 0 ? n_threads : 1;
+  atomic_init(&s->overruns, 0);
+  return s;
+}
+
+void scheduler_free(scheduler_t *s) {
+  assert(s);
+  free(s->slots);
+  free(s);
+  s = NULL;
+}
+
+// PROCESSING ==================================================================
+
+int scheduler_add(scheduler_t *s, ccnc_state_data_t *data) {
+  assert(s && data);
+  if (s->n == s->cap) {
+    size_t cap = s->cap ? s->cap * 2 : 8;
+    sched_slot_t *slots = (sched_slot_t *)realloc(s->slots, cap * sizeof(sched_slot_t));
+    if (!slots) {
+      perror("Could not add machine to scheduler");
+      return 1;
+    }
+    s->slots = slots;
+    s->cap = cap;
+  }
+  memset(&s->slots[s->n], 0, sizeof(sched_slot_t));
+  s->slots[s->n].data = data;
+  s->slots[s->n].state = CCNC_STATE_INIT;
+  s->n++;
+  return 0;
+}
+
+int scheduler_run(scheduler_t *s) {
+  assert(s);
+  size_t i, n_threads = MIN(s->n_threads, s->n);
+  pthread_t *threads = (pthread_t *)calloc(n_threads, sizeof(pthread_t));
+  sched_worker_t *workers = (sched_worker_t *)calloc(n_threads, sizeof(sched_worker_t));
+  int rv = 0;
+  if (!threads || !workers) {
+    perror("Could not allocate scheduler threads");
+    free(threads);
+    free(workers);
+    return 1;
+  }
+  for (i = 0; i < n_threads; i++) {
+    workers[i].s = s;
+    workers[i].id = i;
+    if (pthread_create(&threads[i], NULL, sched_worker, &workers[i])) {
+      perror("Could not start scheduler thread");
+      n_threads = i;
+      rv = 1;
+      break;
+    }
+  }
+  for (i = 0; i < n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  free(workers);
+  return rv;
+}
+
+// GETTERS =====================================================================
+
+size_t scheduler_length(const scheduler_t *s) {
+  assert(s);
+  return s->n;
+}
+
+size_t scheduler_overruns(const scheduler_t *s) {
+  assert(s);
+  return atomic_load(&((scheduler_t *)s)->overruns);
+}
+
+
+//   ____  _        _   _         __
+//  / ___|| |_ __ _| |_(_) ___   / _|_   _ _ __   ___
+//  \___ \| __/ _` | __| |/ __| | |_| | | | '_ \ / __|
+//   ___) | || (_| | |_| | (__  |  _| |_| | | | | (__
+//  |____/ \__\__,_|\__|_|\___| |_|  \__,_|_| |_|\___|
+
+// Worker thread: ticks each of its machines when due, then sleeps until the
+// earliest deadline among them
+static void *sched_worker(void *arg) {
+  sched_worker_t *w = (sched_worker_t *)arg;
+  scheduler_t *s = w->s;
+  sched_slot_t *slot;
+  size_t i, active;
+  uint64_t next;
+  do {
+    active = 0;
+    next = UINT64_MAX;
+    for (i = w->id; i < s->n; i += s->n_threads) {
+      slot = &s->slots[i];
+      if (slot->done) continue;
+      if (now_ns() >= slot->deadline) {
+        sched_tick(s, slot);
+      }
+      if (slot->done) continue;
+      active++;
+      next = MIN(next, slot->deadline);
+    }
+    if (active) sleep_until(next);
+  } while (active);
+  return NULL;
+}
+
+// Run one FSM step and set the next deadline
+static void sched_tick(scheduler_t *s, sched_slot_t *slot) {
+  machine_t *m;
+  uint64_t now;
+  slot->state = ccnc_run_state(slot->state, slot->data);
+  if (slot->state == CCNC_STATE_STOP) {
+    ccnc_run_state(slot->state, slot->data);
+    slot->done = 1;
+    return;
+  }
+  now = now_ns();
+  // the machine object is created by the init state
+  if (slot->period == 0 && (m = slot->data->machine)) {
+    slot->period = machine_simulate(m) ? 0 : machine_tq(m) * 1E9 / machine_rt_pacing(m);
+    slot->deadline = now;
+  }
+  slot->deadline += slot->period;
+  // flow control: run ahead while the plant has room in its buffer
+  if (slot->data->machine && ccnc_credit(slot->data) > 0) {
+    slot->deadline = now;
+    return;
+  }
+  // more than one period late: skip the missed ticks rather than bursting
+  if (slot->period && slot->deadline + slot->period < now) {
+    atomic_fetch_add(&s->overruns, 1);
+    slot->deadline = now + slot->period;
+  }
+}
+
+static void sleep_until(uint64_t t) {
+  uint64_t now = now_ns();
+  struct timespec ts;
+  if (t <= now) return;
+  ts.tv_sec = (t - now) / 1000000000ULL;
+  ts.tv_nsec = (t - now) % 1000000000ULL;
+  nanosleep(&ts, NULL);
+}
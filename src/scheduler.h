@@ -0,0 +1,56 @@
+//   ____       _              _       _
+//  / ___|  ___| |__   ___  __| |_   _| | ___ _ __
+//  \___ \ / __| '_ \ / _ \/ _` | | | | |/ _ \ '__|
+//   ___) | (__| | | |  __/ (_| | |_| | |  __/ |
+//  |____/ \___|_| |_|\___|\__,_|\__,_|_|\___|_|
+//  Runs several C-CNC FSM instances on a small pool of threads, each
+//  machine ticking at its own period (tq / rt_pacing)
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "defines.h"
+#include "fsm_la.h"
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque structure
+typedef struct scheduler scheduler_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+// Create a scheduler using n_threads worker threads
+scheduler_t *scheduler_new(size_t n_threads);
+void scheduler_free(scheduler_t *s);
+
+// PROCESSING ==================================================================
+
+// Add a machine, given its (initialized) FSM state data; the FSM starts
+// from CCNC_STATE_INIT. Machines must run headless, for the idle state
+// would otherwise block a worker on the keyboard.
+// Return value is 0 on success
+int scheduler_add(scheduler_t *s, ccnc_state_data_t *data);
+
+// Run all machines until each of them reaches the stop state
+// Return value is 0 on success
+int scheduler_run(scheduler_t *s);
+
+// GETTERS =====================================================================
+
+size_t scheduler_length(const scheduler_t *s);
+
+// Number of ticks that started later than one period after their deadline
+size_t scheduler_overruns(const scheduler_t *s);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,196 @@
+//   ____                                  _
+//  / ___|  ___  __ _ _ __ ___   ___ _ __ | |_
+//  \___ \ / _ \/ _` | '_ ` _ \ / _ \ '_ \| __|
+//   ___) |  __/ (_| | | | | | |  __/ | | | |_
+//  |____/ \___|\__, |_| |_| |_|\___|_| |_|\__|
+//              |___/
+
+#include "segment.h"
+
+#define SEGMENT_NFIELDS 23
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static void segment_fields(segment_t *s, coord_t *f[SEGMENT_NFIELDS]);
+static void put_le(uint8_t *p, uint64_t v, size_t n);
+static uint64_t get_le(const uint8_t *p, size_t n);
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+size_t segment_encode(const segment_t *s, void *buf, size_t len) {
+  assert(s && buf);
+  uint8_t *p = (uint8_t *)buf;
+  coord_t *f[SEGMENT_NFIELDS];
+  uint64_t u64;
+  double d;
+  int i;
+
+  if (len < SEGMENT_LEN) return 0;
+  p[0] = SEGMENT_MAGIC;
+  p[1] = SEGMENT_VERSION;
+  p[2] = s->type;
+  p[3] = s->flags;
+  put_le(p + 4, s->seq, 4);
+  put_le(p + 8, s->n, 4);
+  put_le(p + 12, 0, 4);
+  segment_fields((segment_t *)s, f);
+  for (i = 0; i < SEGMENT_NFIELDS; i++) {
+    d = (double)*f[i];
+    memcpy(&u64, &d, 8);
+    put_le(p + SEGMENT_HEADER_LEN + 8 * i, u64, 8);
+  }
+  return SEGMENT_LEN;
+}
+
+int segment_decode(const void *buf, size_t len, segment_t *s) {
+  assert(buf && s);
+  const uint8_t *p = (const uint8_t *)buf;
+  coord_t *f[SEGMENT_NFIELDS];
+  uint64_t u64;
+  double d;
+  int i;
+
+  if (len < SEGMENT_LEN || p[0] != SEGMENT_MAGIC) return 1;
+  if (p[1] != SEGMENT_VERSION) {
+    eprintf("Unsupported segment payload version %d\n", p[1]);
+    return 1;
+  }
+  memset(s, 0, sizeof(segment_t));
+  s->type = p[2];
+  s->flags = p[3];
+  s->seq = (uint32_t)get_le(p + 4, 4);
+  s->n = (uint32_t)get_le(p + 8, 4);
+  segment_fields(s, f);
+  for (i = 0; i < SEGMENT_NFIELDS; i++) {
+    u64 = get_le(p + SEGMENT_HEADER_LEN + 8 * i, 8);
+    memcpy(&d, &u64, 8);
+    *f[i] = d;
+  }
+  return 0;
+}
+
+// Same phases as block_lambda(): ramp, cruise, ramp, with signed
+// accelerations; lambda is then mapped on the line or arc
+void segment_eval(const segment_t *s, data_t t, coord_t xyz[3], data_t *v) {
+  assert(s && xyz);
+  coord_t r, tau, lambda, vel;
+
+  if (s->l <= 0) {
+    r = 0;
+    vel = 0;
+    lambda = 1;
+  }
+  else {
+    if (t <= 0) {
+      r = 0;
+      vel = s->fs;
+    }
+    else if (t < s->dt_1) {
+      r = s->fs * t + s->a * pow(t, 2) / 2.0;
+      vel = s->fs + s->a * t;
+    }
+    else if (t < s->dt_1 + s->dt_m) {
+      r = (s->fs + s->f) / 2.0 * s->dt_1 + s->f * (t - s->dt_1);
+      vel = s->f;
+    }
+    else if (t < s->dt_1 + s->dt_m + s->dt_2) {
+      tau = t - s->dt_1 - s->dt_m;
+      r = (s->fs + s->f) / 2.0 * s->dt_1 + s->f * s->dt_m + s->f * tau + s->d / 2.0 * pow(tau, 2);
+      vel = s->f + s->d * tau;
+    }
+    else {
+      r = s->l;
+      vel = s->fe;
+    }
+    lambda = MIN(r / s->l, 1.0);
+  }
+  if (s->type == SEGMENT_ARC_CW || s->type == SEGMENT_ARC_CCW) {
+    xyz[0] = s->center[0] + s->r * cos(s->theta0 + s->dtheta * lambda);
+    xyz[1] = s->center[1] + s->r * sin(s->theta0 + s->dtheta * lambda);
+  }
+  else {
+    xyz[0] = s->p0[0] + s->delta[0] * lambda;
+    xyz[1] = s->p0[1] + s->delta[1] * lambda;
+  }
+  xyz[2] = s->p0[2] + s->delta[2] * lambda;
+  if (v) *v = vel;
+}
+
+
+//   ____  _        _   _         __
+//  / ___|| |_ __ _| |_(_) ___   / _|_   _ _ __   ___
+//  \___ \| __/ _` | __| |/ __| | |_| | | | '_ \ / __|
+//   ___) | || (_| | |_| | (__  |  _| |_| | | | | (__
+//  |____/ \__\__,_|\__|_|\___| |_|  \__,_|_| |_|\___|
+
+// Floating point fields, in wire order
+static void segment_fields(segment_t *s, coord_t *f[SEGMENT_NFIELDS]) {
+  coord_t *list[SEGMENT_NFIELDS] = {
+    &s->t0, &s->p0[0], &s->p0[1], &s->p0[2],
+    &s->delta[0], &s->delta[1], &s->delta[2],
+    &s->center[0], &s->center[1], &s->center[2],
+    &s->r, &s->theta0, &s->dtheta, &s->l,
+    &s->fs, &s->f, &s->fe, &s->a, &s->d,
+    &s->dt_1, &s->dt_m, &s->dt_2, &s->dt
+  };
+  memcpy(f, list, sizeof(list));
+}
+
+// Little endian store and load of n bytes, regardless of the host order
+static void put_le(uint8_t *p, uint64_t v, size_t n) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static uint64_t get_le(const uint8_t *p, size_t n) {
+  uint64_t v = 0;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    v |= (uint64_t)p[i] << (8 * i);
+  }
+  return v;
+}
+
+
+//   _____ _____ ____ _____   __  __       _       
+//  |_   _| ____/ ___|_   _| |  \/  | __ _(_)_ __  
+//    | | |  _| \___ \ | |   | |\/| |/ _` | | '_ \
+//    | | | |___ ___) || |   | |  | | (_| | | | | |
+//    |_| |_____|____/ |_|   |_|  |_|\__,_|_|_| |_|
+// Only needed for testing purpose. To enable, compile as:
+// clang src/segment.c -o segment -lm -DSEGMENT_MAIN
+#ifdef SEGMENT_MAIN
+int main() {
+  // quarter of a circle, radius 10 around (10, 0), from the origin, with
+  // a symmetric trapezoidal profile: 1 s ramps at 5 mm/s^2, 5 mm/s cruise
+  segment_t s = {.seq = 7, .n = 30, .type = SEGMENT_ARC_CCW, .t0 = 1.5,
+    .p0 = {0, 0, 1}, .delta = {10, -10, 0}, .center = {10, 0, 1},
+    .r = 10, .theta0 = M_PI, .dtheta = M_PI / 2, .l = 10 * M_PI / 2,
+    .fs = 0, .f = 5, .fe = 0, .a = 5, .d = -5,
+    .dt_1 = 1, .dt_m = 10 * M_PI / 2 / 5 - 1, .dt_2 = 1};
+  segment_t out;
+  uint8_t buf[SEGMENT_LEN];
+  coord_t xyz[3];
+  data_t v, t;
+  size_t n;
+
+  s.dt = s.dt_1 + s.dt_m + s.dt_2;
+  n = segment_encode(&s, buf, sizeof(buf));
+  if (segment_decode(buf, n, &out) || memcmp(&s, &out, sizeof(s))) {
+    eprintf("Round trip failed\n");
+    return 1;
+  }
+  printf("%zu bytes, seq=%u n=%u t0=%f dt=%f\n", n, out.seq, out.n, out.t0, out.dt);
+  printf("t,x,y,z,v\n");
+  for (t = 0; t < out.dt + 0.5; t += 0.5) {
+    segment_eval(&out, t, xyz, &v);
+    printf("%f,%f,%f,%f,%f\n", t, xyz[0], xyz[1], xyz[2], v);
+  }
+  return 0;
+}
+#endif
@@ -0,0 +1,91 @@
+//   ____                                  _
+//  / ___|  ___  __ _ _ __ ___   ___ _ __ | |_
+//  \___ \ / _ \/ _` | '_ ` _ \ / _ \ '_ \| __|
+//   ___) |  __/ (_| | | | | | |  __/ | | | |_
+//  |____/ \___|\__, |_| |_| |_|\___|_| |_|\__|
+//              |___/
+//  Trajectory segments: the geometry and velocity profile of a whole block,
+//  streamed to the plant instead of sampled setpoints. The receiver samples
+//  the segment locally with segment_eval(), at any rate. This module only
+//  depends on defines.h, so that it can be embedded on the plant side.
+//
+//  Binary layout (little endian, no padding):
+//    offset size
+//         0    1  magic, SEGMENT_MAGIC
+//         1    1  version, SEGMENT_VERSION
+//         2    1  type (SEGMENT_LINE, SEGMENT_ARC_CW, SEGMENT_ARC_CCW)
+//         3    1  flags (SEGMENT_RAPID)
+//         4    4  sequence number (uint32)
+//         8    4  block number (uint32)
+//        12    4  reserved (0)
+//        16  184  23 float64: t0, p0[3], delta[3], center[3], r, theta0,
+//                 dtheta, l, fs, f, fe, a, d, dt_1, dt_m, dt_2, dt
+//
+//  Timing: t0 is the start time of the segment on the program clock, which
+//  restarts from 0 with each program (the first segment has t0 = 0).
+//  Consecutive segments are joined without gaps, unless t0 says otherwise.
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "defines.h"
+
+#define SEGMENT_MAGIC 0xCD
+#define SEGMENT_VERSION 1
+#define SEGMENT_HEADER_LEN 16
+#define SEGMENT_LEN (SEGMENT_HEADER_LEN + 23 * 8)
+
+// Flags
+#define SEGMENT_RAPID 0x01
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Segment types (same values as block_type_t)
+typedef enum {
+  SEGMENT_LINE = 1,
+  SEGMENT_ARC_CW,
+  SEGMENT_ARC_CCW
+} segment_type_t;
+
+// Segment: geometry, offset-compensated, plus the trapezoidal profile of
+// the curvilinear abscissa (see block_lambda()). All in coord_t, like the
+// double wire format
+typedef struct {
+  uint32_t seq;                 // sequence number
+  uint32_t n;                   // block number
+  uint8_t type;                 // segment_type_t
+  uint8_t flags;                // SEGMENT_RAPID
+  coord_t t0;                   // start time, program clock (s)
+  coord_t p0[3];                // start point
+  coord_t delta[3];             // end point - start point
+  coord_t center[3];            // arc center
+  coord_t r, theta0, dtheta;    // arc radius, initial angle, arc angle
+  coord_t l;                    // length
+  coord_t fs, f, fe;            // initial, nominal and final feedrate (mm/s)
+  coord_t a, d;                 // signed accelerations of the two ramps
+  coord_t dt_1, dt_m, dt_2, dt; // phase durations and total time (s)
+} segment_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// Encode s into buf (len bytes available)
+// Return value is the payload length, 0 if buf is too small
+size_t segment_encode(const segment_t *s, void *buf, size_t len);
+
+// Decode a segment payload; return value is 0 on success
+int segment_decode(const void *buf, size_t len, segment_t *s);
+
+// Position at time t from the segment start (clamped to the segment), and
+// feedrate in v (mm/s, may be NULL)
+void segment_eval(const segment_t *s, data_t t, coord_t xyz[3], data_t *v);
+
+#endif // SEGMENT_H
@@ -0,0 +1,296 @@
+//   ____       _               _       _
+//  / ___|  ___| |_ _ __   ___ (_)_ __ | |_
+//  \___ \ / _ \ __| '_ \ / _ \| | '_ \| __|
+//   ___) |  __/ |_| |_) | (_) | | | | | |_
+//  |____/ \___|\__| .__/ \___/|_|_| |_|\__|
+//                 |_|
+
+#include "setpoint.h"
+
+#define JSON_LEN SETPOINT_JSON_LEN
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static void put_le(uint8_t *p, uint64_t v, size_t n);
+static uint64_t get_le(const uint8_t *p, size_t n);
+static int json_value(const char *json, const char *key, const char **val);
+static size_t binary_len(const uint8_t *p);
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+int setpoint_format(const char *name) {
+  assert(name);
+  if (!name[0] || strcmp(name, "json") == 0) return SETPOINT_JSON;
+  if (strcmp(name, "binary64") == 0) return SETPOINT_BINARY64;
+  if (strcmp(name, "binary32") == 0) return SETPOINT_BINARY32;
+  return -1;
+}
+
+size_t setpoint_encode(const setpoint_msg_t *sp, setpoint_format_t fmt, void *buf, size_t len) {
+  assert(sp && buf);
+  uint8_t *p = (uint8_t *)buf;
+  size_t w = (fmt == SETPOINT_BINARY32) ? 4 : 8;
+  coord_t xyz[9] = {sp->x, sp->y, sp->z, sp->v[0], sp->v[1], sp->v[2],
+                    sp->a[0], sp->a[1], sp->a[2]};
+  size_t nc = (sp->flags & SETPOINT_FF) ? 9 : 3;
+  uint64_t u64;
+  uint32_t u32;
+  float f;
+  double d;
+  int i, n;
+
+  if (fmt == SETPOINT_JSON) {
+    if (sp->flags & SETPOINT_FF) {
+      n = snprintf((char *)buf, len,
+        "{\"x\":%f,\"y\":%f,\"z\":%f,\"vx\":%f,\"vy\":%f,\"vz\":%f,"
+        "\"ax\":%f,\"ay\":%f,\"az\":%f,\"rapid\":%s,\"seq\":%u,\"t\":%llu}",
+        sp->x, sp->y, sp->z, sp->v[0], sp->v[1], sp->v[2],
+        sp->a[0], sp->a[1], sp->a[2],
+        (sp->flags & SETPOINT_RAPID) ? "true" : "false",
+        sp->seq, (unsigned long long)sp->t);
+    }
+    else {
+      n = snprintf((char *)buf, len,
+        "{\"x\":%f,\"y\":%f,\"z\":%f,\"rapid\":%s,\"seq\":%u,\"t\":%llu}",
+        sp->x, sp->y, sp->z, (sp->flags & SETPOINT_RAPID) ? "true" : "false",
+        sp->seq, (unsigned long long)sp->t);
+    }
+    return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+  }
+  if (len < SETPOINT_HEADER_LEN + nc * w) return 0;
+  p[0] = SETPOINT_MAGIC;
+  p[1] = SETPOINT_VERSION;
+  p[2] = (uint8_t)w;
+  p[3] = sp->flags;
+  put_le(p + 4, sp->seq, 4);
+  put_le(p + 8, sp->t, 8);
+  for (i = 0; i < (int)nc; i++) {
+    if (w == 4) {
+      f = (float)xyz[i];
+      memcpy(&u32, &f, 4);
+      put_le(p + SETPOINT_HEADER_LEN + 4 * i, u32, 4);
+    } else {
+      d = (double)xyz[i];
+      memcpy(&u64, &d, 8);
+      put_le(p + SETPOINT_HEADER_LEN + 8 * i, u64, 8);
+    }
+  }
+  return SETPOINT_HEADER_LEN + nc * w;
+}
+
+int setpoint_decode(const void *buf, size_t len, setpoint_msg_t *sp) {
+  assert(buf && sp);
+  const uint8_t *p = (const uint8_t *)buf;
+  char json[JSON_LEN];
+  const char *val;
+  coord_t *xyz[9] = {&sp->x, &sp->y, &sp->z, &sp->v[0], &sp->v[1], &sp->v[2],
+                     &sp->a[0], &sp->a[1], &sp->a[2]};
+  const char *ff[6] = {"vx", "vy", "vz", "ax", "ay", "az"};
+  uint64_t u64;
+  uint32_t u32;
+  float f;
+  double d;
+  size_t w, nc;
+  int i;
+
+  memset(sp, 0, sizeof(setpoint_msg_t));
+  if (len == 0) return 1;
+  // JSON: x, y and z are mandatory, the other fields are optional
+  if (p[0] == '{') {
+    if (len >= JSON_LEN) return 1;
+    memcpy(json, buf, len);
+    json[len] = '\0';
+    if (json_value(json, "x", &val)) return 1;
+    sp->x = atof(val);
+    if (json_value(json, "y", &val)) return 1;
+    sp->y = atof(val);
+    if (json_value(json, "z", &val)) return 1;
+    sp->z = atof(val);
+    if (json_value(json, "rapid", &val) == 0 && strncmp(val, "true", 4) == 0)
+      sp->flags |= SETPOINT_RAPID;
+    if (json_value(json, "seq", &val) == 0)
+      sp->seq = (uint32_t)strtoul(val, NULL, 10);
+    if (json_value(json, "t", &val) == 0)
+      sp->t = strtoull(val, NULL, 10);
+    // feed-forward: all six fields, or none
+    for (i = 0; i < 6 && json_value(json, ff[i], &val) == 0; i++);
+    if (i < 6) return 0;
+    for (i = 0; i < 6; i++) {
+      json_value(json, ff[i], &val);
+      *xyz[3 + i] = atof(val);
+    }
+    sp->flags |= SETPOINT_FF;
+    return 0;
+  }
+  // binary
+  if (len < SETPOINT_HEADER_LEN || p[0] != SETPOINT_MAGIC) return 1;
+  if (p[1] != SETPOINT_VERSION) {
+    eprintf("Unsupported setpoint payload version %d\n", p[1]);
+    return 1;
+  }
+  w = p[2];
+  nc = (p[3] & SETPOINT_FF) ? 9 : 3;
+  if ((w != 4 && w != 8) || len < SETPOINT_HEADER_LEN + nc * w) return 1;
+  sp->flags = p[3];
+  sp->seq = (uint32_t)get_le(p + 4, 4);
+  sp->t = get_le(p + 8, 8);
+  for (i = 0; i < (int)nc; i++) {
+    if (w == 4) {
+      u32 = (uint32_t)get_le(p + SETPOINT_HEADER_LEN + 4 * i, 4);
+      memcpy(&f, &u32, 4);
+      *xyz[i] = f;
+    } else {
+      u64 = get_le(p + SETPOINT_HEADER_LEN + 8 * i, 8);
+      memcpy(&d, &u64, 8);
+      *xyz[i] = d;
+    }
+  }
+  return 0;
+}
+
+size_t setpoint_encode_batch(const setpoint_msg_t *sp, size_t n, setpoint_format_t fmt, void *buf, size_t len) {
+  assert(sp && buf);
+  char *p = (char *)buf;
+  size_t i, used = 0, l;
+
+  if (n == 1) return setpoint_encode(sp, fmt, buf, len);
+  if (fmt == SETPOINT_JSON) {
+    if (len < 2) return 0;
+    p[used++] = '[';
+  }
+  for (i = 0; i < n; i++) {
+    if (fmt == SETPOINT_JSON && i > 0) {
+      if (used + 1 >= len) return 0;
+      p[used++] = ',';
+    }
+    if (!(l = setpoint_encode(&sp[i], fmt, p + used, len - used))) return 0;
+    used += l;
+  }
+  if (fmt == SETPOINT_JSON) {
+    if (used + 2 > len) return 0;
+    p[used++] = ']';
+    p[used] = '\0';
+  }
+  return used;
+}
+
+size_t setpoint_decode_batch(const void *buf, size_t len, setpoint_msg_t *sp, size_t max) {
+  assert(buf && sp);
+  const char *p = (const char *)buf, *end = p + len, *close;
+  size_t n = 0, w;
+
+  if (len == 0 || max == 0) return 0;
+  // JSON array: decode each object in turn
+  if (p[0] == '[') {
+    while (n < max && (p = memchr(p, '{', end - p)) &&
+           (close = memchr(p, '}', end - p))) {
+      if (setpoint_decode(p, close - p + 1, &sp[n]) == 0) n++;
+      p = close + 1;
+    }
+    return n;
+  }
+  if (p[0] == '{') {
+    return setpoint_decode(buf, len, sp) == 0 ? 1 : 0;
+  }
+  // binary: each setpoint's length follows from its own header
+  while (n < max && p + SETPOINT_HEADER_LEN <= end &&
+         (w = binary_len((const uint8_t *)p)) && p + w <= end &&
+         setpoint_decode(p, w, &sp[n]) == 0) {
+    n++;
+    p += w;
+  }
+  return n;
+}
+
+
+//   ____  _        _   _         __
+//  / ___|| |_ __ _| |_(_) ___   / _|_   _ _ __   ___
+//  \___ \| __/ _` | __| |/ __| | |_| | | | '_ \ / __|
+//   ___) | || (_| | |_| | (__  |  _| |_| | | | | (__
+//  |____/ \__\__,_|\__|_|\___| |_|  \__,_|_| |_|\___|
+
+// Little endian store and load of n bytes, regardless of the host order
+static void put_le(uint8_t *p, uint64_t v, size_t n) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static uint64_t get_le(const uint8_t *p, size_t n) {
+  uint64_t v = 0;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    v |= (uint64_t)p[i] << (8 * i);
+  }
+  return v;
+}
+
+// Length of the binary setpoint starting at p, from its header
+static size_t binary_len(const uint8_t *p) {
+  return SETPOINT_HEADER_LEN + ((p[3] & SETPOINT_FF) ? 9 : 3) * (size_t)p[2];
+}
+
+// Point val to the value of "key" in a flat JSON object; 0 if found
+static int json_value(const char *json, const char *key, const char **val) {
+  char pattern[JSON_LEN];
+  const char *p;
+  snprintf(pattern, JSON_LEN, "\"%s\":", key);
+  if (!(p = strstr(json, pattern))) return 1;
+  p += strlen(pattern);
+  while (*p == ' ') p++;
+  *val = p;
+  return 0;
+}
+
+
+//   _____ _____ ____ _____   __  __       _       
+//  |_   _| ____/ ___|_   _| |  \/  | __ _(_)_ __  
+//    | | |  _| \___ \ | |   | |\/| |/ _` | | '_ \
+//    | | | |___ ___) || |   | |  | | (_| | | | | |
+//    |_| |_____|____/ |_|   |_|  |_|\__,_|_|_| |_|
+// Only needed for testing purpose. To enable, compile as:
+// clang src/setpoint.c -o setpoint -DSETPOINT_MAIN
+#ifdef SETPOINT_MAIN
+int main() {
+  setpoint_msg_t sp = {.x = 100.123456789, .y = -20.5, .z = 3.25e-3,
+                       .v = {100, -50, 0.5}, .a = {1000, 0, -20},
+                       .seq = 42, .t = 1234567890123ULL, .flags = SETPOINT_RAPID};
+  setpoint_msg_t out;
+  setpoint_msg_t batch[4], outb[4];
+  uint8_t buf[4 * JSON_LEN];
+  const char *names[] = {"json", "binary64", "binary32"};
+  size_t n, k;
+  int i;
+
+  // without, then with feed-forward
+  for (i = 0; i < 6; i++) {
+    if (i == 3) sp.flags |= SETPOINT_FF;
+    n = setpoint_encode(&sp, setpoint_format(names[i % 3]), buf, JSON_LEN);
+    if (setpoint_decode(buf, n, &out)) {
+      eprintf("%s: decoding failed\n", names[i % 3]);
+      return 1;
+    }
+    printf("%-8s %3zu bytes: x=%.9f y=%.9f z=%.9f seq=%u t=%llu rapid=%d\n",
+      names[i % 3], n, out.x, out.y, out.z, out.seq, (unsigned long long)out.t,
+      out.flags & SETPOINT_RAPID);
+    if (out.flags & SETPOINT_FF) {
+      printf("%-8s      ff: v=(%.3f, %.3f, %.3f) a=(%.3f, %.3f, %.3f)\n",
+        names[i % 3], out.v[0], out.v[1], out.v[2], out.a[0], out.a[1], out.a[2]);
+    }
+    for (k = 0; k < 4; k++) {
+      batch[k] = sp;
+      batch[k].seq = sp.seq + k;
+      batch[k].x += k;
+    }
+    n = setpoint_encode_batch(batch, 4, setpoint_format(names[i % 3]), buf, sizeof(buf));
+    k = setpoint_decode_batch(buf, n, outb, 4);
+    printf("%-8s batch of %zu in %3zu bytes, last seq=%u x=%.6f\n", names[i % 3],
+      k, n, outb[k - 1].seq, outb[k - 1].x);
+  }
+  return 0;
+}
+#endif
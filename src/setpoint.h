@@ -0,0 +1,89 @@
+//   ____       _               _       _
+//  / ___|  ___| |_ _ __   ___ (_)_ __ | |_
+//  \___ \ / _ \ __| '_ \ / _ \| | '_ \| __|
+//   ___) |  __/ |_| |_) | (_) | | | | | |_
+//  |____/ \___|\__| .__/ \___/|_|_| |_|\__|
+//                 |_|
+//  Setpoint message payloads: JSON text, or a compact binary format
+//
+//  Binary layout (little endian, no padding):
+//    offset size
+//         0    1  magic, SETPOINT_MAGIC
+//         1    1  version, SETPOINT_VERSION
+//         2    1  bytes per coordinate: 8 (float64) or 4 (float32)
+//         3    1  flags (SETPOINT_RAPID, ...)
+//         4    4  sequence number (uint32)
+//         8    8  timestamp, ns (uint64)
+//        16  3*w  x, y, z (w = bytes per coordinate)
+//      16+3w 6*w  vx, vy, vz, ax, ay, az, only if SETPOINT_FF is set
+//  A JSON payload always begins with '{', so the two formats can be told
+//  apart from the first byte.
+//  Feed-forward velocity (mm/s) and acceleration (mm/s^2) are optional; in
+//  JSON they are the vx, vy, vz, ax, ay, az fields.
+//  Batches of setpoints are sent as consecutive binary setpoints, each with
+//  its own header, or as a JSON array of objects.
+
+#ifndef SETPOINT_H
+#define SETPOINT_H
+
+#include "defines.h"
+
+#define SETPOINT_MAGIC 0xCC
+#define SETPOINT_VERSION 1
+#define SETPOINT_HEADER_LEN 16
+#define SETPOINT_MAX_LEN (SETPOINT_HEADER_LEN + 9 * 8)
+#define SETPOINT_JSON_LEN 256 // max length of one JSON setpoint
+
+// Flags
+#define SETPOINT_RAPID 0x01
+#define SETPOINT_FF 0x02        // carries velocity and acceleration
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Payload formats, as named in the INI file (json, binary64, binary32)
+typedef enum {
+  SETPOINT_JSON = 0,
+  SETPOINT_BINARY64,
+  SETPOINT_BINARY32
+} setpoint_format_t;
+
+// Decoded setpoint (in coord_t, like the segments)
+typedef struct {
+  coord_t x, y, z;              // offset-compensated setpoint
+  coord_t v[3], a[3];           // feed-forward, valid if SETPOINT_FF is set
+  uint32_t seq;                 // sequence number
+  uint64_t t;                   // timestamp (ns)
+  uint8_t flags;                // SETPOINT_RAPID, SETPOINT_FF
+} setpoint_msg_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// Format from its INI name; -1 if unknown
+int setpoint_format(const char *name);
+
+// Encode sp into buf (len bytes available) in the given format
+// Return value is the payload length, 0 if buf is too small
+size_t setpoint_encode(const setpoint_msg_t *sp, setpoint_format_t fmt, void *buf, size_t len);
+
+// Decode a payload in any format into sp
+// Return value is 0 on success
+int setpoint_decode(const void *buf, size_t len, setpoint_msg_t *sp);
+
+// Encode n setpoints into a single payload
+// Return value is the payload length, 0 if buf is too small
+size_t setpoint_encode_batch(const setpoint_msg_t *sp, size_t n, setpoint_format_t fmt, void *buf, size_t len);
+
+// Decode up to max setpoints from a single or batched payload
+// Return value is the number of decoded setpoints
+size_t setpoint_decode_batch(const void *buf, size_t len, setpoint_msg_t *sp, size_t max);
+
+#endif // SETPOINT_H
@@ -0,0 +1,135 @@
+//   _____    _                     _
+//  |_   _|__| | ___ _ __ ___   ___| |_ _ __ _   _
+//    | |/ _ \ |/ _ \ '_ ` _ \ / _ \ __| '__| | | |
+//    | |  __/ |  __/ | | | | |  __/ |_| |  | |_| |
+//    |_|\___|_|\___|_| |_| |_|\___|\__|_|   \__, |
+//                                           |___/
+
+#include "telemetry.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+#define NAME_LEN 256
+
+typedef struct telemetry {
+  char name[NAME_LEN];
+  int writer;                   // 1 on the controller side
+  telemetry_shm_t *shm;
+} telemetry_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+telemetry_t *telemetry_new(const char *name) {
+  assert(name);
+  telemetry_t *t = (telemetry_t *)calloc(1, sizeof(telemetry_t));
+  int fd;
+  if (!t) {
+    perror("Error creating telemetry object");
+    return NULL;
+  }
+  strncpy(t->name, name, NAME_LEN - 1);
+  t->writer = 1;
+  fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(telemetry_shm_t))) {
+    perror("Could not create the telemetry shared memory");
+    if (fd >= 0) close(fd);
+    free(t);
+    return NULL;
+  }
+  t->shm = (telemetry_shm_t *)mmap(NULL, sizeof(telemetry_shm_t),
+    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (t->shm == MAP_FAILED) {
+    perror("Could not map the telemetry shared memory");
+    free(t);
+    return NULL;
+  }
+  // the header is written last: readers check the magic first
+  t->shm->magic = 0;
+  memset(&t->shm->snap, 0, sizeof(telemetry_snapshot_t));
+  seqlock_init(&t->shm->lock);
+  t->shm->version = TELEMETRY_VERSION;
+  t->shm->size = sizeof(telemetry_snapshot_t);
+  t->shm->pid = (int32_t)getpid();
+  atomic_thread_fence(memory_order_release);
+  t->shm->magic = TELEMETRY_MAGIC;
+  eprintf("-> Telemetry on shared memory %s\n", name);
+  return t;
+}
+
+telemetry_t *telemetry_open(const char *name) {
+  assert(name);
+  telemetry_t *t = (telemetry_t *)calloc(1, sizeof(telemetry_t));
+  struct stat st;
+  int fd;
+  if (!t) {
+    perror("Error creating telemetry object");
+    return NULL;
+  }
+  strncpy(t->name, name, NAME_LEN - 1);
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0 || fstat(fd, &st) || (size_t)st.st_size < sizeof(telemetry_shm_t)) {
+    eprintf("No telemetry on %s: is c-cnc running with telemetry set?\n", name);
+    if (fd >= 0) close(fd);
+    free(t);
+    return NULL;
+  }
+  t->shm = (telemetry_shm_t *)mmap(NULL, sizeof(telemetry_shm_t), PROT_READ,
+    MAP_SHARED, fd, 0);
+  close(fd);
+  if (t->shm == MAP_FAILED) {
+    perror("Could not map the telemetry shared memory");
+    free(t);
+    return NULL;
+  }
+  atomic_thread_fence(memory_order_acquire);
+  if (t->shm->magic != TELEMETRY_MAGIC || t->shm->version != TELEMETRY_VERSION ||
+      t->shm->size != sizeof(telemetry_snapshot_t)) {
+    eprintf("Telemetry %s has an unknown layout\n", name);
+    telemetry_free(t);
+    return NULL;
+  }
+  return t;
+}
+
+void telemetry_free(telemetry_t *t) {
+  assert(t);
+  if (t->shm && t->shm != MAP_FAILED) {
+    munmap(t->shm, sizeof(telemetry_shm_t));
+  }
+  if (t->writer) {
+    shm_unlink(t->name);
+  }
+  free(t);
+}
+
+// OPERATIONS ==================================================================
+
+void telemetry_write(telemetry_t *t, const telemetry_snapshot_t *s) {
+  assert(t && t->writer && s);
+  seqlock_write(&t->shm->lock, &t->shm->snap, s, sizeof(telemetry_snapshot_t));
+}
+
+uint32_t telemetry_read(telemetry_t *t, telemetry_snapshot_t *s) {
+  assert(t && s);
+  return seqlock_read(&t->shm->lock, s, &t->shm->snap, sizeof(telemetry_snapshot_t)) / 2;
+}
+
+int telemetry_pid(const telemetry_t *t) {
+  assert(t);
+  return t->shm->pid;
+}
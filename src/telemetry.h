@@ -0,0 +1,89 @@
+//   _____    _                     _
+//  |_   _|__| | ___ _ __ ___   ___| |_ _ __ _   _
+//    | |/ _ \ |/ _ \ '_ ` _ \ / _ \ __| '__| | | |
+//    | |  __/ |  __/ | | | | |  __/ |_| |  | |_| |
+//    |_|\___|_|\___|_| |_| |_|\___|\__|_|   \__, |
+//                                           |___/
+//  Controller state in a POSIX shared memory object, for local monitors:
+//  the controller writes a snapshot every tick under a seqlock, readers
+//  copy it at their own rate and never block the writer. The layout is
+//  fixed (doubles, whatever data_t is) and versioned, so that tools in
+//  other languages can map it too:
+//    telemetry_shm_t: magic, version, snapshot size, writer pid, seqlock
+//    counter (one cache line), then the telemetry_snapshot_t
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "defines.h"
+#include "lockfree.h"
+
+#define TELEMETRY_MAGIC 0x4D4C4554 // "TELM"
+#define TELEMETRY_VERSION 3
+#define TELEMETRY_STATE_LEN 16
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque struct
+typedef struct telemetry telemetry_t;
+
+typedef struct {
+  char state[TELEMETRY_STATE_LEN]; // FSM state name, null-terminated
+  uint64_t tick;                // control loop ticks so far
+  uint64_t n;                   // current block number
+  double t_tot, t_blk;          // program and block timers (s)
+  double lambda, feed;          // curvilinear abscissa (0-1), feed (mm/min)
+  double override;              // feed override factor
+  double setpoint[3];           // last setpoint (mm)
+  double position[3];           // last reported position (mm)
+  double error;                 // last reported positioning error (mm)
+  double position_est[3];       // latency-compensated position (mm)
+  double error_est;             // latency-compensated error (mm)
+  double period, period_mean, period_max; // tick period: last, mean, max (s)
+  double late_max;              // max wake-up delay past the tick (s)
+} telemetry_snapshot_t;
+
+// Memory layout of the shared object
+typedef struct {
+  uint32_t magic, version, size;
+  int32_t pid;
+  seqlock_t lock;
+  char pad[LF_CACHELINE - 4 * sizeof(uint32_t) - sizeof(seqlock_t)];
+  telemetry_snapshot_t snap;
+} telemetry_shm_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+// Writer side: create (or take over) the shared object name, as in
+// shm_open(); it is removed by telemetry_free()
+telemetry_t *telemetry_new(const char *name);
+
+// Reader side: map an existing object, read-only
+telemetry_t *telemetry_open(const char *name);
+
+void telemetry_free(telemetry_t *t);
+
+// OPERATIONS ==================================================================
+
+// Writer: publish a new snapshot; no system calls
+void telemetry_write(telemetry_t *t, const telemetry_snapshot_t *s);
+
+// Reader: copy the latest consistent snapshot into s; return value is its
+// version, which grows at each write (0: nothing written yet)
+uint32_t telemetry_read(telemetry_t *t, telemetry_snapshot_t *s);
+
+// Reader: pid of the writer, to detect a stale object
+int telemetry_pid(const telemetry_t *t);
+
+#endif // TELEMETRY_H
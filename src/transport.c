@@ -0,0 +1,739 @@
+//   _____                                       _
+//  |_   _| __ __ _ _ __  ___ _ __   ___  _ __| |_
+//    | || '__/ _` | '_ \/ __| '_ \ / _ \| '__| __|
+//    | || | | (_| | | | \__ \ |_) | (_) | |  | |_
+//    |_||_|  \__,_|_| |_|___/ .__/ \___/|_|   \__|
+//                           |_|
+
+#include "transport.h"
+#include "inic.h"
+#include "iolog.h"
+#include "lockfree.h"
+#include <mosquitto.h>
+#include <mqtt_protocol.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+#define SHM_SLOT_LEN 4096  // bytes per shm ring slot, length and frame
+#define SHM_READY 2        // shm header state once the rings are initialized
+#define SHM_WAIT_MS 1000   // max wait for the peer to initialize the rings
+#define UDP_MAX_LEN 65507  // max UDP payload
+
+// Backend interface
+typedef struct {
+  const char *name;
+  int (*connect)(transport_t *t);
+  int (*publish)(transport_t *t, const char *topic, const void *payload, size_t len);
+  int (*poll)(transport_t *t, int timeout_ms);
+  int (*subscribe)(transport_t *t, const char *topic);
+  int (*unsubscribe)(transport_t *t, const char *topic);
+  int (*pending)(transport_t *t);
+  void (*disconnect)(transport_t *t);
+  void (*destroy)(transport_t *t);
+} transport_ops_t;
+
+// Header of the shared memory object, followed by the two rings: the first
+// one from controller to plant, the second one from plant to controller
+typedef struct {
+  _Atomic uint32_t state;       // 0: new, 1: initializing, SHM_READY
+  uint32_t slots;               // ring capacity
+  uint32_t slot_len;            // ring element size
+  char pad[LF_CACHELINE - 3 * sizeof(uint32_t)];
+} shm_header_t;
+
+typedef struct transport {
+  const transport_ops_t *ops;
+  transport_cfg_t cfg;
+  transport_on_message cb;
+  void *ud;
+  // mqtt
+  struct mosquitto *mqt;
+  int connecting;               // 1 until connected, -1 if refused
+  int alias_max;                // topic aliases granted by the broker
+  int n_alias;                  // topic aliases in use
+  char alias[TRANSPORT_MAX_ALIASES][TRANSPORT_TOPIC_LEN + 1]; // by alias - 1
+  mosquitto_property *alias_prop[TRANSPORT_MAX_ALIASES]; // alias properties
+  // shm
+  int shm_fd;
+  void *shm;                    // mapped object
+  size_t shm_len;               // its size
+  spsc_t *tx, *rx;              // outgoing and incoming rings
+  // udp
+  int fd;
+  struct sockaddr_in peer;      // where messages are sent
+  int has_peer;                 // plant side: peer known once it has sent
+  // shm and udp
+  uint8_t *tx_frame, *rx_frame; // one outgoing and one incoming message
+  // record and replay
+  iolog_t *log;                 // every message in and out, if recording
+  iolog_t *replay;              // log being replayed
+  iolog_record_t rec;           // next replayed record, if rec_valid
+  int rec_valid, replay_end;
+  size_t published, replayed;   // outgoing messages: sent, and matched in the log
+  size_t delivered;             // incoming messages replayed
+  size_t unrecorded;            // messages too large for the log
+} transport_t;
+
+// libmosquitto is initialized once per process, for the first transport,
+// and cleaned up with the last one
+static atomic_int _mosquitto_users = 0;
+static pthread_mutex_t _mosquitto_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static int mqtt_connect(transport_t *t);
+static int mqtt_publish(transport_t *t, const char *topic, const void *payload, size_t len);
+static int mqtt_poll(transport_t *t, int timeout_ms);
+static int mqtt_subscribe(transport_t *t, const char *topic);
+static int mqtt_unsubscribe(transport_t *t, const char *topic);
+static int mqtt_pending(transport_t *t);
+static void mqtt_disconnect(transport_t *t);
+static void mqtt_destroy(transport_t *t);
+static void mqtt_on_connect(struct mosquitto *mqt, void *obj, int rc);
+static void mqtt_on_connect_v5(struct mosquitto *mqt, void *obj, int rc, int flags, const mosquitto_property *props);
+static int mqtt_alias(transport_t *t, const char *topic, int *first);
+static void mqtt_on_message(struct mosquitto *mqt, void *obj, const struct mosquitto_message *msg);
+static int replay_connect(transport_t *t);
+static int replay_publish(transport_t *t, const char *topic, const void *payload, size_t len);
+static int replay_poll(transport_t *t, int timeout_ms);
+static void replay_disconnect(transport_t *t);
+static void deliver(transport_t *t, const char *topic, const void *payload, size_t len);
+static void record(transport_t *t, iolog_dir_t dir, const char *topic, const void *payload, size_t len);
+static int shm_connect(transport_t *t);
+static int shm_publish(transport_t *t, const char *topic, const void *payload, size_t len);
+static int shm_poll(transport_t *t, int timeout_ms);
+static void shm_disconnect(transport_t *t);
+static int udp_connect(transport_t *t);
+static int udp_publish(transport_t *t, const char *topic, const void *payload, size_t len);
+static int udp_poll(transport_t *t, int timeout_ms);
+static void udp_disconnect(transport_t *t);
+static size_t frame_encode(uint8_t *buf, size_t len, const char *topic, const void *payload, size_t plen);
+static void frame_deliver(transport_t *t, uint8_t *frame, size_t len);
+
+static const transport_ops_t _ops[] = {
+  [TRANSPORT_MQTT] = {"mqtt", mqtt_connect, mqtt_publish, mqtt_poll,
+    mqtt_subscribe, mqtt_unsubscribe, mqtt_pending, mqtt_disconnect,
+    mqtt_destroy},
+  [TRANSPORT_SHM] = {"shm", shm_connect, shm_publish, shm_poll,
+    NULL, NULL, NULL, shm_disconnect, NULL},
+  [TRANSPORT_UDP] = {"udp", udp_connect, udp_publish, udp_poll,
+    NULL, NULL, NULL, udp_disconnect, NULL},
+  [TRANSPORT_REPLAY] = {"replay", replay_connect, replay_publish, replay_poll,
+    NULL, NULL, NULL, replay_disconnect, NULL},
+};
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// CONFIGURATION ===============================================================
+
+void transport_defaults(transport_cfg_t *cfg) {
+  assert(cfg);
+  memset(cfg, 0, sizeof(transport_cfg_t));
+  cfg->type = TRANSPORT_MQTT;
+  strcpy(cfg->broker_address, "localhost");
+  cfg->broker_port = 1883;
+  cfg->protocol = 3;
+  strcpy(cfg->shm_name, "/c-cnc");
+  cfg->shm_slots = 256;
+  cfg->udp_port = 9100;
+  strcpy(cfg->udp_peer, "127.0.0.1");
+  cfg->udp_peer_port = 9101;
+}
+
+int transport_config(transport_cfg_t *cfg, void *ini) {
+  assert(cfg && ini);
+  char type[TRANSPORT_NAME_LEN] = "";
+  int rc = 0, slots = 0, i;
+
+  ini_get_opt_char(ini, "TRANSPORT", "type", type, TRANSPORT_NAME_LEN);
+  for (i = 0; i < (int)(sizeof(_ops) / sizeof(_ops[0])); i++) {
+    if (strcmp(type, _ops[i].name) == 0) cfg->type = i;
+  }
+  if (type[0] && strcmp(type, _ops[cfg->type].name) != 0) {
+    eprintf("Unknown transport %s\n", type);
+    rc++;
+  }
+  // the broker is mandatory when using it
+  if (ini_get_opt_char(ini, "MQTT", "broker_addr", cfg->broker_address, TRANSPORT_NAME_LEN) ||
+      ini_get_opt_int(ini, "MQTT", "broker_port", &cfg->broker_port)) {
+    rc += (cfg->type == TRANSPORT_MQTT);
+  }
+  ini_get_opt_int(ini, "MQTT", "protocol", &cfg->protocol);
+  if (cfg->protocol != 3 && cfg->protocol != 5) {
+    eprintf("Unknown MQTT protocol %d (3 or 5)\n", cfg->protocol);
+    rc++;
+  }
+  ini_get_opt_char(ini, "TRANSPORT", "shm_name", cfg->shm_name, TRANSPORT_NAME_LEN);
+  if (ini_get_opt_int(ini, "TRANSPORT", "shm_slots", &slots) == 0) {
+    if (slots < 2) {
+      eprintf("shm_slots must be at least 2\n");
+      rc++;
+    }
+    cfg->shm_slots = MAX(slots, 2);
+  }
+  ini_get_opt_int(ini, "TRANSPORT", "udp_port", &cfg->udp_port);
+  ini_get_opt_char(ini, "TRANSPORT", "udp_peer", cfg->udp_peer, TRANSPORT_NAME_LEN);
+  ini_get_opt_int(ini, "TRANSPORT", "udp_peer_port", &cfg->udp_peer_port);
+  ini_get_opt_char(ini, "TRANSPORT", "record", cfg->record, TRANSPORT_NAME_LEN);
+  if (ini_get_opt_char(ini, "TRANSPORT", "replay", cfg->replay, TRANSPORT_NAME_LEN) && cfg->type == TRANSPORT_REPLAY) {
+    eprintf("The replay transport needs a replay log\n");
+    rc++;
+  }
+  return rc;
+}
+
+// LIFECYCLE ===================================================================
+
+transport_t *transport_new(const transport_cfg_t *cfg, transport_on_message cb, void *ud) {
+  assert(cfg);
+  transport_t *t = (transport_t *)calloc(1, sizeof(transport_t));
+  if (!t) {
+    perror("Could not allocate transport");
+    return NULL;
+  }
+  t->cfg = *cfg;
+  t->ops = &_ops[cfg->type];
+  t->cb = cb;
+  t->ud = ud;
+  t->shm_fd = t->fd = -1;
+  if (cfg->type == TRANSPORT_MQTT) {
+    pthread_mutex_lock(&_mosquitto_lock);
+    if (atomic_load(&_mosquitto_users) == 0 &&
+        mosquitto_lib_init() != MOSQ_ERR_SUCCESS) {
+      pthread_mutex_unlock(&_mosquitto_lock);
+      eprintf("Could not initialize Mosquitto library\n");
+      free(t);
+      return NULL;
+    }
+    atomic_fetch_add(&_mosquitto_users, 1);
+    pthread_mutex_unlock(&_mosquitto_lock);
+  }
+  else {
+    t->tx_frame = (uint8_t *)malloc(MAX(SHM_SLOT_LEN, UDP_MAX_LEN + 1));
+    t->rx_frame = (uint8_t *)malloc(MAX(SHM_SLOT_LEN, UDP_MAX_LEN + 1));
+    if (!t->tx_frame || !t->rx_frame) {
+      free(t->tx_frame);
+      free(t->rx_frame);
+      perror("Could not allocate transport buffer");
+      free(t);
+      return NULL;
+    }
+  }
+  if (cfg->record[0]) {
+    if (!(t->log = iolog_new(cfg->record, 1))) {
+      transport_free(t);
+      return NULL;
+    }
+    eprintf("-> Recording messages into %s\n", cfg->record);
+  }
+  return t;
+}
+
+void transport_free(transport_t *t) {
+  assert(t);
+  if (t->ops->destroy) t->ops->destroy(t);
+  if (t->shm) munmap(t->shm, t->shm_len);
+  if (t->shm_fd >= 0) close(t->shm_fd);
+  if (t->fd >= 0) close(t->fd);
+  free(t->tx_frame);
+  free(t->rx_frame);
+  if (t->unrecorded)
+    eprintf("-> %zu messages too large for %s, not recorded\n", t->unrecorded, t->cfg.record);
+  if (t->log) iolog_free(t->log);
+  if (t->replay) iolog_free(t->replay);
+  free(t);
+}
+
+// OPERATIONS ==================================================================
+
+int transport_connect(transport_t *t) {
+  assert(t);
+  return t->ops->connect(t);
+}
+
+int transport_publish(transport_t *t, const char *topic, const void *payload, size_t len) {
+  assert(t && topic && (payload || len == 0));
+  if (t->log) record(t, IOLOG_OUT, topic, payload, len);
+  return t->ops->publish(t, topic, payload, len);
+}
+
+int transport_poll(transport_t *t, int timeout_ms) {
+  assert(t);
+  return t->ops->poll(t, timeout_ms);
+}
+
+int transport_subscribe(transport_t *t, const char *topic) {
+  assert(t && topic);
+  return t->ops->subscribe ? t->ops->subscribe(t, topic) : 0;
+}
+
+int transport_unsubscribe(transport_t *t, const char *topic) {
+  assert(t && topic);
+  return t->ops->unsubscribe ? t->ops->unsubscribe(t, topic) : 0;
+}
+
+int transport_pending(transport_t *t) {
+  assert(t);
+  return t->ops->pending ? t->ops->pending(t) : 0;
+}
+
+void transport_disconnect(transport_t *t) {
+  assert(t);
+  t->ops->disconnect(t);
+}
+
+// ACCESSORS ===================================================================
+
+const char *transport_name(const transport_t *t) {
+  assert(t);
+  return t->ops->name;
+}
+
+
+//   __  __  ___ _____ _____
+//  |  \/  |/ _ \_   _|_   _|
+//  | |\/| | | | || |   | |
+//  | |  | | |_| || |   | |
+//  |_|  |_|\__\_\|_|   |_|
+
+static int mqtt_connect(transport_t *t) {
+  mosquitto_property *props = NULL;
+  int rc;
+  t->mqt = mosquitto_new(NULL, 1, t);
+  if (!t->mqt) {
+    perror("Could not create MQTT");
+    return 1;
+  }
+  mosquitto_message_callback_set(t->mqt, mqtt_on_message);
+  if (t->cfg.protocol == 5) {
+    // the broker may alias the topics it sends to us, too
+    mosquitto_int_option(t->mqt, MOSQ_OPT_PROTOCOL_VERSION, MQTT_PROTOCOL_V5);
+    mosquitto_connect_v5_callback_set(t->mqt, mqtt_on_connect_v5);
+    mosquitto_property_add_int16(&props, MQTT_PROP_TOPIC_ALIAS_MAXIMUM, TRANSPORT_MAX_ALIASES);
+    rc = mosquitto_connect_bind_v5(t->mqt, t->cfg.broker_address, t->cfg.broker_port, 60, NULL, props);
+    mosquitto_property_free_all(&props);
+  }
+  else {
+    mosquitto_connect_callback_set(t->mqt, mqtt_on_connect);
+    rc = mosquitto_connect(t->mqt, t->cfg.broker_address, t->cfg.broker_port, 60);
+  }
+  if (rc != MOSQ_ERR_SUCCESS) {
+    perror("Could not connect to broker");
+    return 2;
+  }
+  // wait for connection to establish
+  t->connecting = 1;
+  while (t->connecting > 0) {
+    mosquitto_loop(t->mqt, -1, 1);
+  }
+  return t->connecting < 0 ? 3 : 0;
+}
+
+// With an alias, the topic is only sent on its first message
+static int mqtt_publish(transport_t *t, const char *topic, const void *payload, size_t len) {
+  int a, first;
+  if (t->cfg.protocol != 5 || !(a = mqtt_alias(t, topic, &first))) {
+    return mosquitto_publish(t->mqt, NULL, topic, (int)len, payload, 0, 0) != MOSQ_ERR_SUCCESS;
+  }
+  return mosquitto_publish_v5(t->mqt, NULL, first ? topic : NULL, (int)len, payload,
+    0, 0, t->alias_prop[a - 1]) != MOSQ_ERR_SUCCESS;
+}
+
+static int mqtt_poll(transport_t *t, int timeout_ms) {
+  return mosquitto_loop(t->mqt, timeout_ms, 1) != MOSQ_ERR_SUCCESS;
+}
+
+static int mqtt_subscribe(transport_t *t, const char *topic) {
+  return mosquitto_subscribe(t->mqt, NULL, topic, 0) != MOSQ_ERR_SUCCESS;
+}
+
+static int mqtt_unsubscribe(transport_t *t, const char *topic) {
+  return mosquitto_unsubscribe(t->mqt, NULL, topic) != MOSQ_ERR_SUCCESS;
+}
+
+static int mqtt_pending(transport_t *t) {
+  return t->mqt && mosquitto_want_write(t->mqt);
+}
+
+static void mqtt_disconnect(transport_t *t) {
+  if (t->mqt) mosquitto_disconnect(t->mqt);
+}
+
+static void mqtt_destroy(transport_t *t) {
+  int i;
+  if (t->mqt) mosquitto_destroy(t->mqt);
+  for (i = 0; i < TRANSPORT_MAX_ALIASES; i++) {
+    mosquitto_property_free_all(&t->alias_prop[i]);
+  }
+  pthread_mutex_lock(&_mosquitto_lock);
+  if (atomic_fetch_sub(&_mosquitto_users, 1) == 1) {
+    mosquitto_lib_cleanup();
+  }
+  pthread_mutex_unlock(&_mosquitto_lock);
+}
+
+static void mqtt_on_connect(struct mosquitto *mqt, void *obj, int rc) {
+  transport_t *t = (transport_t *)obj;
+  int i;
+  // Failed to connect
+  if (rc != CONNACK_ACCEPTED) {
+    eprintf("-X Connection error: %s\n", mosquitto_connack_string(rc));
+    t->connecting = -1;
+    return;
+  }
+  // Successful connection
+  eprintf("-> Connected to %s:%d\n", t->cfg.broker_address, t->cfg.broker_port);
+  for (i = 0; i < TRANSPORT_MAX_SUBS && t->cfg.subs[i]; i++) {
+    if (!t->cfg.subs[i][0]) continue;
+    if (mosquitto_subscribe(mqt, NULL, t->cfg.subs[i], 0) != MOSQ_ERR_SUCCESS) {
+      eprintf("Could not subscribe to %s\n", t->cfg.subs[i]);
+      t->connecting = -1;
+      return;
+    }
+  }
+  t->connecting = 0;
+}
+
+// MQTT v5: the CONNACK tells how many topic aliases the broker accepts, and
+// the aliases of any previous connection are gone
+static void mqtt_on_connect_v5(struct mosquitto *mqt, void *obj, int rc, int flags, const mosquitto_property *props) {
+  transport_t *t = (transport_t *)obj;
+  uint16_t max = 0;
+  mosquitto_property_read_int16(props, MQTT_PROP_TOPIC_ALIAS_MAXIMUM, &max, false);
+  t->alias_max = MIN(max, TRANSPORT_MAX_ALIASES);
+  t->n_alias = 0;
+  mqtt_on_connect(mqt, obj, rc);
+  if (rc == CONNACK_ACCEPTED) {
+    eprintf("-> MQTT v5, %d topic aliases\n", t->alias_max);
+  }
+}
+
+// Alias of topic (1 to alias_max), assigning a new one if there is room
+// (first is then 1); 0 if none
+static int mqtt_alias(transport_t *t, const char *topic, int *first) {
+  int i;
+  *first = 0;
+  for (i = 0; i < t->n_alias; i++) {
+    if (strcmp(t->alias[i], topic) == 0) return i + 1;
+  }
+  if (t->n_alias == t->alias_max || strlen(topic) > TRANSPORT_TOPIC_LEN) return 0;
+  strcpy(t->alias[i], topic);
+  // the property lists are built once, and reused on every message
+  if (!t->alias_prop[i] &&
+      mosquitto_property_add_int16(&t->alias_prop[i], MQTT_PROP_TOPIC_ALIAS, (uint16_t)(i + 1)) != MOSQ_ERR_SUCCESS) {
+    return 0;
+  }
+  t->n_alias++;
+  *first = 1;
+  return i + 1;
+}
+
+static void mqtt_on_message(struct mosquitto *mqt, void *obj, const struct mosquitto_message *msg) {
+  deliver((transport_t *)obj, msg->topic, msg->payload, msg->payloadlen);
+}
+
+
+//   ____  _   _ __  __
+//  / ___|| | | |  \/  |
+//  \___ \| |_| | |\/| |
+//   ___) |  _  | |  | |
+//  |____/|_| |_|_|  |_|
+
+// Either side may come first: the object is created by the first one, and
+// its rings are initialized by whoever wins the race on the header state
+static int shm_connect(transport_t *t) {
+  size_t ring = spsc_footprint(t->cfg.shm_slots, SHM_SLOT_LEN);
+  uint8_t *base;
+  spsc_t *rings[2];
+  shm_header_t *h;
+  struct stat st;
+  uint32_t state = 0;
+  int i;
+
+  ring = (ring + LF_CACHELINE - 1) / LF_CACHELINE * LF_CACHELINE;
+  t->shm_len = sizeof(shm_header_t) + 2 * ring;
+  t->shm_fd = shm_open(t->cfg.shm_name, O_RDWR | O_CREAT, 0600);
+  if (t->shm_fd < 0) {
+    perror("Could not open the shared memory object");
+    return 1;
+  }
+  if (fstat(t->shm_fd, &st) || (st.st_size == 0 && ftruncate(t->shm_fd, t->shm_len))) {
+    perror("Could not size the shared memory object");
+    return 1;
+  }
+  if (st.st_size != 0 && (size_t)st.st_size != t->shm_len) {
+    eprintf("Shared memory %s has a different size: check shm_slots on both sides\n", t->cfg.shm_name);
+    return 1;
+  }
+  t->shm = mmap(NULL, t->shm_len, PROT_READ | PROT_WRITE, MAP_SHARED, t->shm_fd, 0);
+  if (t->shm == MAP_FAILED) {
+    t->shm = NULL;
+    perror("Could not map the shared memory object");
+    return 1;
+  }
+  base = (uint8_t *)t->shm;
+  h = (shm_header_t *)base;
+  rings[0] = (spsc_t *)(base + sizeof(shm_header_t));
+  rings[1] = (spsc_t *)(base + sizeof(shm_header_t) + ring);
+  if (atomic_compare_exchange_strong(&h->state, &state, 1)) {
+    h->slots = (uint32_t)t->cfg.shm_slots;
+    h->slot_len = SHM_SLOT_LEN;
+    spsc_init(rings[0], t->cfg.shm_slots, SHM_SLOT_LEN);
+    spsc_init(rings[1], t->cfg.shm_slots, SHM_SLOT_LEN);
+    atomic_store(&h->state, SHM_READY);
+  }
+  for (i = 0; atomic_load(&h->state) != SHM_READY; i++) {
+    if (i == SHM_WAIT_MS) {
+      eprintf("Shared memory %s never got ready\n", t->cfg.shm_name);
+      return 1;
+    }
+    usleep(1000);
+  }
+  t->tx = rings[t->cfg.plant ? 1 : 0];
+  t->rx = rings[t->cfg.plant ? 0 : 1];
+  // leftovers of a previous run: only the consumer may drop them
+  while (spsc_pop(t->rx, t->rx_frame) == 0);
+  eprintf("-> Attached to shared memory %s\n", t->cfg.shm_name);
+  return 0;
+}
+
+static int shm_publish(transport_t *t, const char *topic, const void *payload, size_t len) {
+  size_t n = frame_encode(t->tx_frame + 4, SHM_SLOT_LEN - 4, topic, payload, len);
+  uint32_t n32 = (uint32_t)n;
+  if (!n) {
+    eprintf("Message on %s too large for shared memory\n", topic);
+    return 1;
+  }
+  memcpy(t->tx_frame, &n32, 4);
+  return spsc_push(t->tx, t->tx_frame);
+}
+
+static int shm_poll(transport_t *t, int timeout_ms) {
+  uint32_t n;
+  int waited = 0;
+  // wait for the first message in steps of 100 us
+  while (spsc_count(t->rx) == 0 && waited < timeout_ms * 10) {
+    usleep(100);
+    waited++;
+  }
+  while (spsc_pop(t->rx, t->rx_frame) == 0) {
+    memcpy(&n, t->rx_frame, 4);
+    frame_deliver(t, t->rx_frame + 4, MIN(n, SHM_SLOT_LEN - 5));
+  }
+  return 0;
+}
+
+static void shm_disconnect(transport_t *t) {
+  if (t->shm) {
+    munmap(t->shm, t->shm_len);
+    t->shm = NULL;
+  }
+}
+
+
+//   _   _ ____  ____
+//  | | | |  _ \|  _ \
+//  | | | | | | | |_) |
+//  | |_| | |_| |  __/
+//   \___/|____/|_|
+
+// The controller binds udp_port and sends to udp_peer:udp_peer_port; the
+// plant binds udp_peer_port and answers to whoever sent the last datagram
+static int udp_connect(transport_t *t) {
+  struct sockaddr_in addr = {0};
+  struct addrinfo hints = {0}, *res = NULL;
+  char port[16];
+
+  t->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (t->fd < 0) {
+    perror("Could not create UDP socket");
+    return 1;
+  }
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(t->cfg.plant ? t->cfg.udp_peer_port : t->cfg.udp_port);
+  if (bind(t->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+    perror("Could not bind UDP socket");
+    return 1;
+  }
+  fcntl(t->fd, F_SETFL, fcntl(t->fd, F_GETFL) | O_NONBLOCK);
+  if (t->cfg.plant) {
+    eprintf("-> Listening on UDP port %d\n", t->cfg.udp_peer_port);
+    return 0;
+  }
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  snprintf(port, sizeof(port), "%d", t->cfg.udp_peer_port);
+  if (getaddrinfo(t->cfg.udp_peer, port, &hints, &res) || !res) {
+    eprintf("Could not resolve %s\n", t->cfg.udp_peer);
+    return 1;
+  }
+  memcpy(&t->peer, res->ai_addr, sizeof(t->peer));
+  freeaddrinfo(res);
+  t->has_peer = 1;
+  eprintf("-> Sending to %s:%d over UDP\n", t->cfg.udp_peer, t->cfg.udp_peer_port);
+  return 0;
+}
+
+static int udp_publish(transport_t *t, const char *topic, const void *payload, size_t len) {
+  size_t n;
+  if (!t->has_peer) return 1;
+  if (!(n = frame_encode(t->tx_frame, UDP_MAX_LEN, topic, payload, len))) {
+    eprintf("Message on %s too large for a datagram\n", topic);
+    return 1;
+  }
+  return sendto(t->fd, t->tx_frame, n, 0, (struct sockaddr *)&t->peer, sizeof(t->peer)) != (ssize_t)n;
+}
+
+static int udp_poll(transport_t *t, int timeout_ms) {
+  struct pollfd pfd = {.fd = t->fd, .events = POLLIN};
+  struct sockaddr_in from;
+  socklen_t from_len;
+  ssize_t n;
+
+  if (timeout_ms > 0 && poll(&pfd, 1, timeout_ms) < 0) {
+    perror("UDP poll error");
+    return 1;
+  }
+  for (;;) {
+    from_len = sizeof(from);
+    n = recvfrom(t->fd, t->rx_frame, UDP_MAX_LEN, 0, (struct sockaddr *)&from, &from_len);
+    if (n < 0) break;
+    if (t->cfg.plant) {
+      t->peer = from;
+      t->has_peer = 1;
+    }
+    frame_deliver(t, t->rx_frame, (size_t)n);
+  }
+  return 0;
+}
+
+static void udp_disconnect(transport_t *t) {
+  if (t->fd >= 0) {
+    close(t->fd);
+    t->fd = -1;
+  }
+}
+
+
+//   ____            _
+//  |  _ \ ___ _ __ | | __ _ _   _
+//  | |_) / _ \ '_ \| |/ _` | | | |
+//  |  _ <  __/ |_) | | (_| | |_| |
+//  |_| \_\___| .__/|_|\__,_|\__, |
+//            |_|            |___/
+
+static int replay_connect(transport_t *t) {
+  if (!(t->replay = iolog_new(t->cfg.replay, 0))) {
+    return 1;
+  }
+  eprintf("-> Replaying %s\n", t->cfg.replay);
+  return 0;
+}
+
+static int replay_publish(transport_t *t, const char *topic, const void *payload, size_t len) {
+  t->published++;
+  return 0;
+}
+
+// Deliver the recorded incoming messages up to the first outgoing one that
+// has not been matched by a publish yet; never waits
+static int replay_poll(transport_t *t, int timeout_ms) {
+  int rc;
+  for (;;) {
+    if (!t->rec_valid) {
+      if (t->replay_end) return 0;
+      if ((rc = iolog_read(t->replay, &t->rec))) {
+        if (rc < 0) eprintf("Truncated record in %s\n", t->cfg.replay);
+        eprintf("-> End of the replayed log\n");
+        t->replay_end = 1;
+        return 0;
+      }
+      t->rec_valid = 1;
+    }
+    if (t->rec.dir == IOLOG_IN) {
+      t->rec_valid = 0;
+      t->delivered++;
+      deliver(t, t->rec.topic, t->rec.payload, t->rec.len);
+    }
+    else if (t->published > t->replayed) {
+      t->rec_valid = 0;
+      t->replayed++;
+    }
+    else return 0;
+  }
+}
+
+static void replay_disconnect(transport_t *t) {
+  eprintf("-> Replayed %zu incoming messages; %zu messages published, %zu recorded ones matched\n",
+    t->delivered, t->published, t->replayed);
+}
+
+
+//   _____
+//  |  ___| __ __ _ _ __ ___   ___  ___
+//  | |_ | '__/ _` | '_ ` _ \ / _ \/ __|
+//  |  _|| | | (_| | | | | | |  __/\__ \
+//  |_|  |_|  \__,_|_| |_| |_|\___||___/
+//
+// shm and udp messages: topic length (1 byte), topic, payload
+
+static size_t frame_encode(uint8_t *buf, size_t len, const char *topic, const void *payload, size_t plen) {
+  size_t tlen = strlen(topic);
+  if (tlen > TRANSPORT_TOPIC_LEN || 1 + tlen + plen > len) return 0;
+  buf[0] = (uint8_t)tlen;
+  memcpy(buf + 1, topic, tlen);
+  memcpy(buf + 1 + tlen, payload, plen);
+  return 1 + tlen + plen;
+}
+
+// Deliver a frame to the callback, with a null-terminated topic and payload
+// (as libmosquitto does); frame must have one spare byte past len
+static void frame_deliver(transport_t *t, uint8_t *frame, size_t len) {
+  char topic[TRANSPORT_TOPIC_LEN + 1];
+  size_t tlen;
+  if (len < 1 || (tlen = frame[0]) + 1 > len) return;
+  memcpy(topic, frame + 1, tlen);
+  topic[tlen] = '\0';
+  frame[len] = '\0';
+  deliver(t, topic, frame + 1 + tlen, len - 1 - tlen);
+}
+
+// Every backend hands incoming messages over through here
+static void deliver(transport_t *t, const char *topic, const void *payload, size_t len) {
+  if (t->log) record(t, IOLOG_IN, topic, payload, len);
+  if (t->cb) t->cb(t->ud, topic, payload, len);
+}
+
+// Append a message to the recording. Messages too large for the log are
+// counted and left out; after a write error the log may end with a partial
+// record, so recording stops there rather than going on past it
+static void record(transport_t *t, iolog_dir_t dir, const char *topic, const void *payload, size_t len) {
+  int rc = iolog_write(t->log, dir, topic, payload, len);
+  if (rc > 0) {
+    if (t->unrecorded++ == 0)
+      eprintf("Message on %s too large for the I/O log, not recorded\n", topic);
+  }
+  else if (rc < 0) {
+    eprintf("Could not write %s after %zu records, recording stopped\n", t->cfg.record, iolog_count(t->log));
+    iolog_free(t->log);
+    t->log = NULL;
+  }
+}
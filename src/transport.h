@@ -0,0 +1,119 @@
+//   _____                                       _
+//  |_   _| __ __ _ _ __  ___ _ __   ___  _ __| |_
+//    | || '__/ _` | '_ \/ __| '_ \ / _ \| '__| __|
+//    | || | | (_| | | | \__ \ |_) | (_) | |  | |_
+//    |_||_|  \__,_|_| |_|___/ .__/ \___/|_|   \__|
+//                           |_|
+//  Message transport between the controller and the plant. Messages are
+//  (topic, payload) pairs with the same topic names on every backend:
+//  - mqtt: through a broker (libmosquitto). With MQTT v5, each outgoing
+//          topic is sent in full once, then as a two-byte topic alias, up to
+//          TRANSPORT_MAX_ALIASES topics and as many as the broker allows
+//  - shm:  two lock-free SPSC rings in POSIX shared memory, for a plant
+//          running on the same host
+//  - udp:  datagrams to and from a peer, no broker
+//  - replay: the incoming messages of a log recorded on any backend (see
+//          record), in lockstep with the outgoing ones: after the n-th
+//          publish, the messages that followed the n-th recorded one are
+//          delivered. No peer, no timing: reruns are deterministic
+//  Only the mqtt backend filters by subscription: the others deliver
+//  every message sent by the peer.
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "defines.h"
+
+#define TRANSPORT_NAME_LEN 256
+#define TRANSPORT_MAX_SUBS 4
+#define TRANSPORT_TOPIC_LEN 255 // max topic length on shm and udp
+#define TRANSPORT_MAX_ALIASES 8 // outgoing topics sent as MQTT v5 aliases
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+// Opaque struct
+typedef struct transport transport_t;
+
+// Backends, as named in the INI file
+typedef enum {
+  TRANSPORT_MQTT = 0,
+  TRANSPORT_SHM,
+  TRANSPORT_UDP,
+  TRANSPORT_REPLAY
+} transport_type_t;
+
+// Called for each incoming message, from within transport_poll()
+typedef void (*transport_on_message)(void *ud, const char *topic, const void *payload, size_t len);
+
+// Configuration, see the [TRANSPORT] section of settings.ini
+typedef struct {
+  transport_type_t type;
+  int plant;                              // 1 on the plant side
+  // mqtt
+  char broker_address[TRANSPORT_NAME_LEN];
+  int broker_port;
+  int protocol;                           // MQTT version, 3 (3.1.1) or 5
+  const char *subs[TRANSPORT_MAX_SUBS];   // topics subscribed on connection
+  // shm
+  char shm_name[TRANSPORT_NAME_LEN];      // POSIX shared memory object
+  size_t shm_slots;                       // messages per ring
+  // udp
+  int udp_port;                           // controller port
+  char udp_peer[TRANSPORT_NAME_LEN];      // plant address
+  int udp_peer_port;                      // plant port
+  // record and replay (see iolog.h)
+  char record[TRANSPORT_NAME_LEN];        // log of all the messages, if set
+  char replay[TRANSPORT_NAME_LEN];        // log replayed by the replay type
+} transport_cfg_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// CONFIGURATION ===============================================================
+
+// Fill cfg with the default values (mqtt on localhost:1883)
+void transport_defaults(transport_cfg_t *cfg);
+
+// Read the optional [TRANSPORT] section from an INI file opened with
+// ini_init(); return value is the number of wrong parameters
+int transport_config(transport_cfg_t *cfg, void *ini);
+
+// LIFECYCLE ===================================================================
+
+transport_t *transport_new(const transport_cfg_t *cfg, transport_on_message cb, void *ud);
+void transport_free(transport_t *t);
+
+// OPERATIONS ==================================================================
+// Return values are 0 on success
+
+// Open the channel; blocks until a broker connection is established
+int transport_connect(transport_t *t);
+
+int transport_publish(transport_t *t, const char *topic, const void *payload, size_t len);
+
+// Process pending I/O and deliver incoming messages, waiting up to
+// timeout_ms for the first one (0: do not wait)
+int transport_poll(transport_t *t, int timeout_ms);
+
+// Subscriptions after connection (no-op but on mqtt)
+int transport_subscribe(transport_t *t, const char *topic);
+int transport_unsubscribe(transport_t *t, const char *topic);
+
+// 1 while outgoing data are still waiting to be written
+int transport_pending(transport_t *t);
+
+void transport_disconnect(transport_t *t);
+
+// ACCESSORS ===================================================================
+
+const char *transport_name(const transport_t *t);
+
+#endif // TRANSPORT_H
@@ -15,7 +15,8 @@
 
 #include <unistd.h> // Sleep
 
-static uint64_t now_ns() {
+// Monotonic time in nanoseconds
+uint64_t now_ns(void) {
   static uint64_t is_init = 0;
 #if defined(__APPLE__)
   static mach_timebase_info_data_t info;
@@ -43,16 +44,23 @@ static uint64_t now_ns() {
 }
 
 
-uint64_t wait_next(uint64_t interval) {
-  static uint64_t last_call = 0;
+// Busy-wait until interval ns have passed since the previous call; the
+// time of the previous call is kept in *last_call, so that each caller
+// (e.g. each machine instance) can have its own pacing
+uint64_t wait_next_r(uint64_t interval, uint64_t *last_call) {
   uint64_t delta, delay;
-  if (last_call == 0 || interval == 0) last_call = now_ns();
-  while ((delta = now_ns() - last_call)) {
+  if (*last_call == 0 || interval == 0) *last_call = now_ns();
+  while ((delta = now_ns() - *last_call)) {
     if (delta >= interval) {
       delay = delta - interval;
-      last_call = now_ns() - delay;
+      *last_call = now_ns() - delay;
       return delay;
     }
   }
   return 0;
+}
+
+uint64_t wait_next(uint64_t interval) {
+  static uint64_t last_call = 0;
+  return wait_next_r(interval, &last_call);
 }
\ No newline at end of file
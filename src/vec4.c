@@ -0,0 +1,414 @@
+// __     __        _  _
+// \ \   / /__  ___| || |
+//  \ \ / / _ \/ __| || |_
+//   \ V /  __/ (__|__   _|
+//    \_/ \___|\___|  |_|
+
+#include "vec4.h"
+
+//   ____            _                 _   _
+//  |  _ \  ___  ___| | __ _ _ __ __ _| |_(_) ___  _ __  ___
+//  | | | |/ _ \/ __| |/ _` | '__/ _` | __| |/ _ \| '_ \/ __|
+//  | |_| |  __/ (__| | (_| | | | (_| | |_| | (_) | | | \__ \
+//  |____/ \___|\___|_|\__,_|_|  \__,_|\__|_|\___/|_| |_|___/
+
+// Each instruction set provides reg_t, holding one point, its load, store,
+// sub, min and max, and two steps working on LANES points at once:
+// dot_step() (LANES dot products) and sqrt_step() (LANES square roots, in
+// place). The kernels below are written on these only; the points past
+// the last multiple of LANES go through the scalar functions.
+// With float data_t (see DATA_TYPE in defines.h) a point is a single
+// 128 bit register on both SSE and NEON
+
+#if defined(DATA_TYPE_float) || defined(DATA_TYPE_mixed)
+#define VEC4_FLOAT
+#endif
+
+#if !defined(VEC4_FLOAT) && defined(__AVX__)
+#include <immintrin.h>
+#define VEC4_ISA "avx"
+#define LANES 4
+typedef __m256d reg_t;
+#define reg_load(p) _mm256_load_pd(&(p)->x)
+#define reg_store(p, r) _mm256_store_pd(&(p)->x, r)
+#define reg_sub(a, b) _mm256_sub_pd(a, b)
+#define reg_min(a, b) _mm256_min_pd(a, b)
+#define reg_max(a, b) _mm256_max_pd(a, b)
+
+// the four sums of lanes of s0..s3, in this order: (x + y) + (z + w), with
+// w = 0 the same as the scalar formula
+static inline __m256d hsum4(__m256d s0, __m256d s1, __m256d s2, __m256d s3) {
+  __m256d h01 = _mm256_hadd_pd(s0, s1), h23 = _mm256_hadd_pd(s2, s3);
+  return _mm256_add_pd(_mm256_permute2f128_pd(h01, h23, 0x20),
+    _mm256_permute2f128_pd(h01, h23, 0x31));
+}
+
+static inline void dot_step(const vec4_t *a, const vec4_t *b, data_t *out) {
+  _mm256_storeu_pd(out, hsum4(
+    _mm256_mul_pd(reg_load(a), reg_load(b)),
+    _mm256_mul_pd(reg_load(a + 1), reg_load(b + 1)),
+    _mm256_mul_pd(reg_load(a + 2), reg_load(b + 2)),
+    _mm256_mul_pd(reg_load(a + 3), reg_load(b + 3))));
+}
+
+static inline void sqrt_step(data_t *v) {
+  _mm256_storeu_pd(v, _mm256_sqrt_pd(_mm256_loadu_pd(v)));
+}
+
+#elif !defined(VEC4_FLOAT) && defined(__SSE2__)
+#include <emmintrin.h>
+#define VEC4_ISA "sse2"
+#define LANES 2
+typedef struct { __m128d xy, zw; } reg_t;
+static inline reg_t reg_load(const vec4_t *p) {
+  return (reg_t){_mm_load_pd(&p->x), _mm_load_pd(&p->z)};
+}
+static inline void reg_store(vec4_t *p, reg_t r) {
+  _mm_store_pd(&p->x, r.xy);
+  _mm_store_pd(&p->z, r.zw);
+}
+static inline reg_t reg_sub(reg_t a, reg_t b) {
+  return (reg_t){_mm_sub_pd(a.xy, b.xy), _mm_sub_pd(a.zw, b.zw)};
+}
+static inline reg_t reg_min(reg_t a, reg_t b) {
+  return (reg_t){_mm_min_pd(a.xy, b.xy), _mm_min_pd(a.zw, b.zw)};
+}
+static inline reg_t reg_max(reg_t a, reg_t b) {
+  return (reg_t){_mm_max_pd(a.xy, b.xy), _mm_max_pd(a.zw, b.zw)};
+}
+
+// products of each point as [xx, yy] and [zz, 0], then transposed, so that
+// the sums are in the same order as in the scalar formula
+static inline void dot_step(const vec4_t *a, const vec4_t *b, data_t *out) {
+  __m128d p0 = _mm_mul_pd(_mm_load_pd(&a[0].x), _mm_load_pd(&b[0].x));
+  __m128d q0 = _mm_mul_pd(_mm_load_pd(&a[0].z), _mm_load_pd(&b[0].z));
+  __m128d p1 = _mm_mul_pd(_mm_load_pd(&a[1].x), _mm_load_pd(&b[1].x));
+  __m128d q1 = _mm_mul_pd(_mm_load_pd(&a[1].z), _mm_load_pd(&b[1].z));
+  _mm_storeu_pd(out, _mm_add_pd(
+    _mm_add_pd(_mm_unpacklo_pd(p0, p1), _mm_unpackhi_pd(p0, p1)),
+    _mm_unpacklo_pd(q0, q1)));
+}
+
+static inline void sqrt_step(data_t *v) {
+  _mm_storeu_pd(v, _mm_sqrt_pd(_mm_loadu_pd(v)));
+}
+
+#elif !defined(VEC4_FLOAT) && defined(__aarch64__) && defined(__ARM_NEON)
+// 32 bit ARM NEON has no double lanes: with double data_t, those targets
+// use the scalar path
+#include <arm_neon.h>
+#define VEC4_ISA "neon"
+#define LANES 2
+typedef struct { float64x2_t xy, zw; } reg_t;
+static inline reg_t reg_load(const vec4_t *p) {
+  return (reg_t){vld1q_f64(&p->x), vld1q_f64(&p->z)};
+}
+static inline void reg_store(vec4_t *p, reg_t r) {
+  vst1q_f64(&p->x, r.xy);
+  vst1q_f64(&p->z, r.zw);
+}
+static inline reg_t reg_sub(reg_t a, reg_t b) {
+  return (reg_t){vsubq_f64(a.xy, b.xy), vsubq_f64(a.zw, b.zw)};
+}
+static inline reg_t reg_min(reg_t a, reg_t b) {
+  return (reg_t){vminq_f64(a.xy, b.xy), vminq_f64(a.zw, b.zw)};
+}
+static inline reg_t reg_max(reg_t a, reg_t b) {
+  return (reg_t){vmaxq_f64(a.xy, b.xy), vmaxq_f64(a.zw, b.zw)};
+}
+
+static inline void dot_step(const vec4_t *a, const vec4_t *b, data_t *out) {
+  float64x2_t p0 = vmulq_f64(vld1q_f64(&a[0].x), vld1q_f64(&b[0].x));
+  float64x2_t q0 = vmulq_f64(vld1q_f64(&a[0].z), vld1q_f64(&b[0].z));
+  float64x2_t p1 = vmulq_f64(vld1q_f64(&a[1].x), vld1q_f64(&b[1].x));
+  float64x2_t q1 = vmulq_f64(vld1q_f64(&a[1].z), vld1q_f64(&b[1].z));
+  vst1q_f64(out, vaddq_f64(vaddq_f64(vzip1q_f64(p0, p1), vzip2q_f64(p0, p1)),
+    vzip1q_f64(q0, q1)));
+}
+
+static inline void sqrt_step(data_t *v) {
+  vst1q_f64(v, vsqrtq_f64(vld1q_f64(v)));
+}
+
+#elif defined(VEC4_FLOAT) && defined(__SSE__)
+#include <xmmintrin.h>
+#define VEC4_ISA "sse"
+#define LANES 4
+typedef __m128 reg_t;
+#define reg_load(p) _mm_load_ps(&(p)->x)
+#define reg_store(p, r) _mm_store_ps(&(p)->x, r)
+#define reg_sub(a, b) _mm_sub_ps(a, b)
+#define reg_min(a, b) _mm_min_ps(a, b)
+#define reg_max(a, b) _mm_max_ps(a, b)
+
+// products of four points, transposed into x, y, z and w lanes
+static inline void dot_step(const vec4_t *a, const vec4_t *b, data_t *out) {
+  __m128 p0 = _mm_mul_ps(reg_load(a), reg_load(b));
+  __m128 p1 = _mm_mul_ps(reg_load(a + 1), reg_load(b + 1));
+  __m128 p2 = _mm_mul_ps(reg_load(a + 2), reg_load(b + 2));
+  __m128 p3 = _mm_mul_ps(reg_load(a + 3), reg_load(b + 3));
+  _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+  _mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(p0, p1), p2));
+}
+
+static inline void sqrt_step(data_t *v) {
+  _mm_storeu_ps(v, _mm_sqrt_ps(_mm_loadu_ps(v)));
+}
+
+#elif defined(VEC4_FLOAT) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VEC4_ISA "neon"
+#define LANES 4
+typedef float32x4_t reg_t;
+#define reg_load(p) vld1q_f32(&(p)->x)
+#define reg_store(p, r) vst1q_f32(&(p)->x, r)
+#define reg_sub(a, b) vsubq_f32(a, b)
+#define reg_min(a, b) vminq_f32(a, b)
+#define reg_max(a, b) vmaxq_f32(a, b)
+
+// vld4q_f32() loads four points already split into x, y, z and w lanes
+static inline void dot_step(const vec4_t *a, const vec4_t *b, data_t *out) {
+  float32x4x4_t va = vld4q_f32(&a->x), vb = vld4q_f32(&b->x);
+  vst1q_f32(out, vaddq_f32(vaddq_f32(vmulq_f32(va.val[0], vb.val[0]),
+    vmulq_f32(va.val[1], vb.val[1])), vmulq_f32(va.val[2], vb.val[2])));
+}
+
+#ifdef __aarch64__
+static inline void sqrt_step(data_t *v) {
+  vst1q_f32(v, vsqrtq_f32(vld1q_f32(v)));
+}
+#else
+// 32 bit NEON only has a square root estimate: keep the exact one
+static inline void sqrt_step(data_t *v) {
+  int k;
+  for (k = 0; k < LANES; k++) v[k] = sqrtf(v[k]);
+}
+#endif
+
+#else
+#define VEC4_SCALAR
+#define VEC4_ISA "scalar"
+#define LANES 1
+#endif
+
+// STATIC FUNCTIONS (for internal use only) ====================================
+static inline data_t dot_one(const vec4_t *a, const vec4_t *b);
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+vec4_t *vec4_alloc(size_t n) {
+  void *v = NULL;
+  if (posix_memalign(&v, sizeof(vec4_t), MAX(n, 1) * sizeof(vec4_t))) {
+    perror("Error allocating points");
+    exit(EXIT_FAILURE);
+  }
+  memset(v, 0, MAX(n, 1) * sizeof(vec4_t));
+  return (vec4_t *)v;
+}
+
+// ALGORITHMS ==================================================================
+
+void vec4_delta(const vec4_t *from, const vec4_t *to, vec4_t *d, size_t n) {
+  assert((from && to && d) || n == 0);
+  size_t i;
+#ifdef VEC4_SCALAR
+  for (i = 0; i < n; i++) {
+    vec4_set(&d[i], to[i].x - from[i].x, to[i].y - from[i].y, to[i].z - from[i].z);
+  }
+#else
+  for (i = 0; i < n; i++) {
+    reg_store(&d[i], reg_sub(reg_load(&to[i]), reg_load(&from[i])));
+  }
+#endif
+}
+
+void vec4_dist(const vec4_t *from, const vec4_t *to, data_t *dist, size_t n) {
+  assert((from && to && dist) || n == 0);
+  size_t i = 0;
+#ifndef VEC4_SCALAR
+  vec4_t d[LANES];
+  size_t k;
+  for (; i + LANES <= n; i += LANES) {
+    for (k = 0; k < LANES; k++) {
+      reg_store(&d[k], reg_sub(reg_load(&to[i + k]), reg_load(&from[i + k])));
+    }
+    dot_step(d, d, dist + i);
+    sqrt_step(dist + i);
+  }
+#endif
+  for (; i < n; i++) {
+    vec4_t d1;
+    vec4_set(&d1, to[i].x - from[i].x, to[i].y - from[i].y, to[i].z - from[i].z);
+    dist[i] = sqrt(dot_one(&d1, &d1));
+  }
+}
+
+void vec4_dot(const vec4_t *a, const vec4_t *b, data_t *dot, size_t n) {
+  assert((a && b && dot) || n == 0);
+  size_t i = 0;
+#ifndef VEC4_SCALAR
+  for (; i + LANES <= n; i += LANES) {
+    dot_step(a + i, b + i, dot + i);
+  }
+#endif
+  for (; i < n; i++) {
+    dot[i] = dot_one(&a[i], &b[i]);
+  }
+}
+
+// a.b / (|a| |b|), with the same operations in the same order as the
+// scalar formula; a null vector gives 0/0, NaN
+void vec4_cos(const vec4_t *a, const vec4_t *b, data_t *cos, size_t n) {
+  assert((a && b && cos) || n == 0);
+  size_t i = 0;
+#ifndef VEC4_SCALAR
+  data_t aa[LANES], bb[LANES];
+  size_t k;
+  for (; i + LANES <= n; i += LANES) {
+    dot_step(a + i, b + i, cos + i);
+    dot_step(a + i, a + i, aa);
+    dot_step(b + i, b + i, bb);
+    sqrt_step(aa);
+    sqrt_step(bb);
+    for (k = 0; k < LANES; k++) {
+      cos[i + k] /= aa[k] * bb[k];
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    cos[i] = dot_one(&a[i], &b[i]) /
+      (sqrt(dot_one(&a[i], &a[i])) * sqrt(dot_one(&b[i], &b[i])));
+  }
+}
+
+void vec4_bbox(const vec4_t *p, size_t n, vec4_t *min, vec4_t *max) {
+  assert((p || n == 0) && min && max);
+  size_t i;
+  vec4_set(min, INFINITY, INFINITY, INFINITY);
+  vec4_set(max, -INFINITY, -INFINITY, -INFINITY);
+#ifdef VEC4_SCALAR
+  for (i = 0; i < n; i++) {
+    min->x = MIN(min->x, p[i].x);
+    min->y = MIN(min->y, p[i].y);
+    min->z = MIN(min->z, p[i].z);
+    max->x = MAX(max->x, p[i].x);
+    max->y = MAX(max->y, p[i].y);
+    max->z = MAX(max->z, p[i].z);
+  }
+#else
+  // two chains each, so that a min does not wait for the previous one
+  reg_t lo0 = reg_load(min), hi0 = reg_load(max), lo1 = lo0, hi1 = hi0, r;
+  for (i = 0; i + 2 <= n; i += 2) {
+    r = reg_load(&p[i]);
+    lo0 = reg_min(lo0, r);
+    hi0 = reg_max(hi0, r);
+    r = reg_load(&p[i + 1]);
+    lo1 = reg_min(lo1, r);
+    hi1 = reg_max(hi1, r);
+  }
+  if (i < n) {
+    r = reg_load(&p[i]);
+    lo0 = reg_min(lo0, r);
+    hi0 = reg_max(hi0, r);
+  }
+  reg_store(min, reg_min(lo0, lo1));
+  reg_store(max, reg_max(hi0, hi1));
+#endif
+}
+
+// ACCESSORS ===================================================================
+
+const char *vec4_isa(void) { return VEC4_ISA; }
+
+
+//   ____  _        _   _         __
+//  / ___|| |_ __ _| |_(_) ___   / _|_   _ _ __   ___
+//  \___ \| __/ _` | __| |/ __| | |_| | | | '_ \ / __|
+//   ___) | || (_| | |_| | (__  |  _| |_| | | | | (__
+//  |____/ \__\__,_|\__|_|\___| |_|  \__,_|_| |_|\___|
+
+static inline data_t dot_one(const vec4_t *a, const vec4_t *b) {
+  return a->x * b->x + a->y * b->y + a->z * b->z;
+}
+
+
+//   _____ _____ ____ _____   __  __       _
+//  |_   _| ____/ ___|_   _| |  \/  | __ _(_)_ __
+//    | | |  _| \___ \ | |   | |\/| |/ _` | | '_ \
+//    | | | |___ ___) || |   | |  | | (_| | | | | |
+//    |_| |_____|____/ |_|   |_|  |_|\__,_|_|_| |_|
+// Only needed for testing purpose: checks the kernels against the scalar
+// formulas and measures their throughput. To enable, compile as:
+// clang -O2 src/vec4.c src/utils.c -o vec4 -lm -DVEC4_MAIN
+// (add -mavx, or -march=native, for the AVX path)
+#ifdef VEC4_MAIN
+#define N 1000003
+int main() {
+  vec4_t *a = vec4_alloc(N), *b = vec4_alloc(N), *d = vec4_alloc(N);
+  vec4_t min, max;
+  data_t *r = malloc(N * sizeof(data_t)), e, err = 0;
+  data_t lo[3] = {INFINITY, INFINITY, INFINITY}, hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+  uint64_t t0;
+  size_t i;
+  int k;
+
+  printf("Instruction set: %s\n", vec4_isa());
+  srand(1);
+  for (i = 0; i < N; i++) {
+    vec4_set(&a[i], rand() % 2000 - 1000, rand() % 2000 - 1000, rand() % 200);
+    vec4_set(&b[i], rand() % 2000 - 1000, rand() % 2000 - 1000, rand() % 200);
+    lo[0] = MIN(lo[0], a[i].x); hi[0] = MAX(hi[0], a[i].x);
+    lo[1] = MIN(lo[1], a[i].y); hi[1] = MAX(hi[1], a[i].y);
+    lo[2] = MIN(lo[2], a[i].z); hi[2] = MAX(hi[2], a[i].z);
+  }
+  vec4_set(&b[7], 0, 0, 0); // a null vector: NaN cosine
+
+  vec4_delta(a, b, d, N);
+  for (i = 0; i < N; i++) {
+    err = MAX(err, fabs(d[i].x - (b[i].x - a[i].x)) + fabs(d[i].z - (b[i].z - a[i].z)) + fabs(d[i].w));
+  }
+  printf("delta: max error %g\n", err);
+  vec4_dist(a, b, r, N);
+  for (err = 0, i = 0; i < N; i++) {
+    e = sqrt(pow(b[i].x - a[i].x, 2) + pow(b[i].y - a[i].y, 2) + pow(b[i].z - a[i].z, 2));
+    err = MAX(err, fabs(r[i] - e));
+  }
+  printf("dist:  max error %g\n", err);
+  vec4_cos(a, b, r, N);
+  for (err = 0, i = 0; i < N; i++) {
+    if (i == 7) continue;
+    e = (a[i].x * b[i].x + a[i].y * b[i].y + a[i].z * b[i].z) /
+      (sqrt(a[i].x * a[i].x + a[i].y * a[i].y + a[i].z * a[i].z) *
+       sqrt(b[i].x * b[i].x + b[i].y * b[i].y + b[i].z * b[i].z));
+    err = MAX(err, fabs(r[i] - e));
+  }
+  printf("cos:   max error %g, null vector %f (expected nan)\n", err, r[7]);
+  vec4_bbox(a, N, &min, &max);
+  printf("bbox:  [%g %g %g]-[%g %g %g] (expected [%g %g %g]-[%g %g %g])\n",
+    min.x, min.y, min.z, max.x, max.y, max.z,
+    lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+
+  // throughput, as bytes of points read
+  t0 = now_ns();
+  for (k = 0; k < 20; k++) vec4_dist(a, b, r, N);
+  printf("dist:  %.2f GB/s\n", 20.0 * 2 * N * sizeof(vec4_t) / (now_ns() - t0));
+  t0 = now_ns();
+  for (k = 0; k < 20; k++) vec4_cos(a, b, r, N);
+  printf("cos:   %.2f GB/s\n", 20.0 * 2 * N * sizeof(vec4_t) / (now_ns() - t0));
+  t0 = now_ns();
+  for (k = 0; k < 20; k++) vec4_bbox(a, N - k, &min, &max); // N - k: not hoisted
+  printf("bbox:  %.2f GB/s\n", 20.0 * N * sizeof(vec4_t) / (now_ns() - t0));
+
+  free(a);
+  free(b);
+  free(d);
+  free(r);
+  return 0;
+}
+#endif
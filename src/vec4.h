@@ -0,0 +1,76 @@
+// __     __        _  _
+// \ \   / /__  ___| || |
+//  \ \ / / _ \/ __| || |_
+//   \ V /  __/ (__|__   _|
+//    \_/ \___|\___|  |_|
+//  Packed points for array kernels: x, y, z plus a padding lane w, aligned
+//  to their own size (32 bytes with double data_t), so that each point is
+//  one AVX register or two SSE2/NEON ones (one SSE/NEON register with float
+//  data_t). Whole-program geometry passes (deltas, lengths, junction
+//  cosines, bounding box) run on contiguous arrays of these, rather than
+//  walking the list of point_t objects.
+//  The kernels use AVX, SSE2 or AArch64 NEON (double), SSE or NEON (float)
+//  when the compiler targets them (see the SIMD_NATIVE option in
+//  CMakeLists.txt), plain loops otherwise.
+//  The w lane must be 0 (vec4_set() does that) and is kept 0 by the kernels.
+
+#ifndef VEC4_H
+#define VEC4_H
+
+#include "defines.h"
+
+//   _____
+//  |_   _|   _ _ __   ___  ___
+//    | || | | | '_ \ / _ \/ __|
+//    | || |_| | |_) |  __/\__ \
+//    |_| \__, | .__/ \___||___/
+//        |___/|_|
+
+typedef struct {
+  data_t x, y, z, w;
+} __attribute__((aligned(4 * sizeof(data_t)))) vec4_t;
+
+//   _____                 _   _
+//  |  ___|   _ _ __   ___| |_(_) ___  _ __  ___
+//  | |_ | | | | '_ \ / __| __| |/ _ \| '_ \/ __|
+//  |  _|| |_| | | | | (__| |_| | (_) | | | \__ \
+//  |_|   \__,_|_| |_|\___|\__|_|\___/|_| |_|___/
+
+// LIFECYCLE ===================================================================
+
+// Aligned array of n points, zeroed; release it with free(). malloc() and
+// calloc() do not align past 16 bytes: do not embed vec4_t in their objects
+vec4_t *vec4_alloc(size_t n);
+
+static inline void vec4_set(vec4_t *v, data_t x, data_t y, data_t z) {
+  v->x = x;
+  v->y = y;
+  v->z = z;
+  v->w = 0;
+}
+
+// ALGORITHMS ==================================================================
+// Arrays are n points long; output arrays may alias the inputs
+
+// d[i] = to[i] - from[i]
+void vec4_delta(const vec4_t *from, const vec4_t *to, vec4_t *d, size_t n);
+
+// dist[i] = |to[i] - from[i]|
+void vec4_dist(const vec4_t *from, const vec4_t *to, data_t *dist, size_t n);
+
+// dot[i] = a[i] . b[i]
+void vec4_dot(const vec4_t *a, const vec4_t *b, data_t *dot, size_t n);
+
+// cos[i] = cosine of the angle between a[i] and b[i]; NaN if either is null
+void vec4_cos(const vec4_t *a, const vec4_t *b, data_t *cos, size_t n);
+
+// Bounding box of the n points; with n == 0, min is +inf and max is -inf
+void vec4_bbox(const vec4_t *p, size_t n, vec4_t *min, vec4_t *max);
+
+// ACCESSORS ===================================================================
+
+// Instruction set the kernels were built for: "avx", "sse2", "sse", "neon"
+// or "scalar"
+const char *vec4_isa(void);
+
+#endif // VEC4_H